@@ -4,10 +4,51 @@
 
 #include <random>
 #include <queue>
+#include <set>
 #include <cmath>
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SNAPSHOT_MMAP 1
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define POLYLINE_AVX2 1
+#endif
+
+// Segment lengths have to come out the same whatever the compiler flags, so GCC may not
+// fuse the squares and their sum into one FMA even when it is built for a processor that has it
+#if defined(__GNUC__) && !defined(__clang__)
+#define NO_FP_CONTRACT __attribute__((optimize("fp-contract=off")))
+#else
+#define NO_FP_CONTRACT
+#endif
 
 std::minstd_rand rand_engine; // Reasonably quick pseudo-random generator
 
+// How many crossroads a witness search may settle while building the contraction
+// hierarchy. Missing a witness only costs an extra shortcut, never a wrong route.
+int const WITNESS_SETTLE_LIMIT = 64;
+
+// Landmark table value for crossroads the landmark can't reach
+std::uint32_t const LANDMARK_UNREACHABLE = std::numeric_limits<std::uint32_t>::max();
+
+// A* only uses the landmarks that give the best bound between the route ends
+unsigned int const ACTIVE_LANDMARKS = 4;
+
+// Most way segments in a leaf of the segment box tree
+int const SEGMENT_LEAF_SIZE = 8;
+
 template <typename Type>
 Type random_in_range(Type start, Type end)
 {
@@ -19,6 +60,169 @@ Type random_in_range(Type start, Type end)
     return static_cast<Type>(start+num);
 }
 
+// Splits [0, count) into one contiguous chunk per thread and runs func(begin, end, thread)
+// on each of them. The calling thread does the first chunk itself.
+template <typename Func>
+void parallel_chunks(std::size_t count, unsigned int threads, Func func)
+{
+    threads = std::max(1u, std::min<unsigned int>(threads, count));
+    std::size_t chunk = (count + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    for (unsigned int t = 1; t < threads; ++t) {
+        std::size_t begin = std::min(count, t * chunk);
+        std::size_t end = std::min(count, begin + chunk);
+        workers.emplace_back(func, begin, end, t);
+    }
+    func(0, std::min(count, chunk), 0u);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+// Position of (x, y) along a Hilbert curve over the whole 32-bit grid. Points close to each
+// other on the curve are close on the map too.
+std::uint64_t hilbert_index(std::uint32_t x, std::uint32_t y)
+{
+    std::uint64_t index = 0;
+    for (std::uint32_t s = 1u << 31; s > 0; s >>= 1) {
+        std::uint32_t rx = (x & s) ? 1 : 0;
+        std::uint32_t ry = (y & s) ? 1 : 0;
+        index += static_cast<std::uint64_t>(s) * s * ((3 * rx) ^ ry);
+        //turn the quadrant so the curve inside it starts where the previous one ended
+        if (ry == 0) {
+            if (rx == 1) {
+                x = ~x;
+                y = ~y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return index;
+}
+
+#ifdef POLYLINE_AVX2
+// Splits eight coords starting at "from" into their x and y as floats.
+__attribute__((target("avx2")))
+inline void load_coords_avx2(Coord const* from, __m256& xs, __m256& ys)
+{
+    //x0 y0 x1 y1 x2 y2 x3 y3 -> x0 x1 x2 x3 y0 y1 y2 y3 in both halves
+    __m256i const split = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    __m256i low = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(from)), split);
+    __m256i high = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(from + 4)), split);
+    xs = _mm256_cvtepi32_ps(_mm256_permute2x128_si256(low, high, 0x20));
+    ys = _mm256_cvtepi32_ps(_mm256_permute2x128_si256(low, high, 0x31));
+}
+
+// Lengths of the segments coords[i] -> coords[i+1], eight at a time. The float operations
+// are the same as in way_length, so the lengths are bit for bit the same. Returns how many
+// segments were done, always a multiple of eight.
+__attribute__((target("avx2"))) NO_FP_CONTRACT
+std::size_t segment_lengths_avx2(Coord const* coords, std::size_t count, Distance* lengths)
+{
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 x1, y1, x2, y2;
+        load_coords_avx2(coords + i, x1, y1);
+        load_coords_avx2(coords + i + 1, x2, y2);
+        __m256 dx = _mm256_sub_ps(x1, x2);
+        __m256 dy = _mm256_sub_ps(y1, y2);
+        __m256 squared = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+        //a length is never negative, so truncating is the same as floorf
+        __m256i length = _mm256_cvttps_epi32(_mm256_sqrt_ps(squared));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lengths + i), length);
+    }
+    return i;
+}
+#endif
+
+// Binary snapshot layout: the header, then one 8-byte aligned block per column. Strings
+// and coordinates are shared tables that the *_NAMES, *_IDS and *_COORDS columns index
+// with offset arrays of count+1 entries. All values are in native byte order.
+char const SNAPSHOT_MAGIC[8] = {'P', 'R', 'G', '2', 'S', 'N', 'A', 'P'};
+std::uint32_t const SNAPSHOT_VERSION = 1;
+std::uint32_t const SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+enum Snapshot_block {
+    SNAP_PLACE_IDS,         // int64 per place
+    SNAP_PLACE_TYPES,       // int32 per place
+    SNAP_PLACE_COORDS,      // int32 x, y per place
+    SNAP_PLACE_NAMES,       // uint64 string offsets, places+1
+    SNAP_AREA_IDS,          // int64 per area
+    SNAP_AREA_NAMES,        // uint64 string offsets, areas+1
+    SNAP_AREA_COORDS,       // uint64 coordinate offsets, areas+1
+    SNAP_SUBAREA_IDS,       // int64 per subarea
+    SNAP_SUBAREA_PARENTS,   // int64 per subarea
+    SNAP_WAY_IDS,           // uint64 string offsets, ways+1
+    SNAP_WAY_COORDS,        // uint64 coordinate offsets, ways+1
+    SNAP_WAY_LENGTHS,       // int32 per way, load recomputes them from the coords
+    SNAP_COORDS,            // int32 x, y per coordinate
+    SNAP_STRINGS,           // chars
+    SNAP_BLOCK_COUNT
+};
+
+enum Snapshot_count { SNAP_PLACES, SNAP_AREAS, SNAP_SUBAREAS, SNAP_WAYS, SNAP_COORD_COUNT, SNAP_STRING_BYTES, SNAP_COUNT_COUNT };
+
+struct Snapshot_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint64_t counts[SNAP_COUNT_COUNT];
+    std::uint64_t block_offset[SNAP_BLOCK_COUNT];
+    std::uint64_t block_size[SNAP_BLOCK_COUNT];
+};
+
+// Read-only view of a whole file. Memory mapped where the platform has mmap, read into
+// a buffer otherwise.
+class Mapped_file
+{
+public:
+    explicit Mapped_file(std::string const& filename)
+    {
+#ifdef SNAPSHOT_MMAP
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat info;
+        if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* mapped = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                data_ = static_cast<char const*>(mapped);
+                size_ = info.st_size;
+            }
+        }
+        ::close(fd);
+#else
+        std::ifstream input(filename, std::ios::binary);
+        buffer_.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+#endif
+    }
+
+    ~Mapped_file()
+    {
+#ifdef SNAPSHOT_MMAP
+        if (data_ != nullptr) {
+            ::munmap(const_cast<char*>(data_), size_);
+        }
+#endif
+    }
+
+    Mapped_file(Mapped_file const&) = delete;
+    Mapped_file& operator=(Mapped_file const&) = delete;
+
+    char const* data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+private:
+    char const* data_ = nullptr;
+    std::size_t size_ = 0;
+#ifndef SNAPSHOT_MMAP
+    std::vector<char> buffer_;
+#endif
+};
+
 // Modify the code below to implement the functionality of the class.
 // Also remove comments from the parameter names when you implement
 // an operation (Commenting out parameter name prevents compiler from
@@ -51,6 +255,9 @@ void Datastructures::clear_all()
     placeID_names_map.clear();
     placeID_type_map.clear();
     placeID_coord_map.clear();
+    place_snaps.clear();
+    crossroad_places.clear();
+    place_snaps_epoch = std::numeric_limits<unsigned long int>::max();
 
 }
 
@@ -77,6 +284,9 @@ bool Datastructures::add_place(PlaceID id, const Name& name, PlaceType type, Coo
     placeID_names_map.insert({id, name});
     placeID_type_map.insert({id, type});
     placeID_coord_map.insert({id, xy});
+    if (place_snaps_epoch == graph_epoch) {
+        attach_place(id, xy);
+    }
     return true;
 
 }
@@ -156,9 +366,15 @@ std::vector<Coord> Datastructures::get_area_coords(AreaID id)
 
 void Datastructures::creation_finished()
 {
-    // Replace this comment with your implementation
-    // NOTE!! It's quite ok to leave this empty, if you don't need operations
-    // that are performed after all additions have been done.
+    //renumbering compacts the coord buffer too, otherwise close the holes removed ways left
+    if (hilbert_order) {
+        renumber_crossroads();
+    }
+    else if (way_coord_holes > 0) {
+        compact_way_coords();
+    }
+    //join the places to the way graph in one go
+    attach_places();
 }
 
 
@@ -271,6 +487,10 @@ bool Datastructures::change_place_coord(PlaceID id, Coord newcoord)
     //otherwise find said id, change it's coordinates, return true
     auto find = placeID_coord_map.find(id);
     find->second = newcoord;
+    if (place_snaps_epoch == graph_epoch) {
+        detach_place(id);
+        attach_place(id, newcoord);
+    }
     return true;
 
 }
@@ -355,6 +575,7 @@ bool Datastructures::remove_place(PlaceID id)
     placeID_names_map.erase(id);
     placeID_type_map.erase(id);
     placeID_coord_map.erase(id);
+    detach_place(id);
     areaID_name_map.erase(id);
     areaID_subarea_map.erase(id);
     areaID_coord_map.erase(id);
@@ -393,287 +614,3288 @@ std::vector<WayID> Datastructures::all_ways()
 bool Datastructures::add_way(WayID id, std::vector<Coord> coords)
 {   
     // Checks if ID exist in ways_vector, if not, creates a new way there.
-    for (unsigned long i = 0; i < ways_vector.size(); ++i) {
-        if (ways_vector.at(i).id == id) {
-            return false;
-        }
+    if (wayID_index_map.count(id) > 0 || coords.empty()) {
+        return false;
     }
 
-    //make the new way
-    Way new_way(id, coords);
-    //add nodes
-    make_node(coords.at(0), coords.at(1));
-    if (ways_vector.size() == 1) {
-        new_way.prev = nullptr;
+    //make the new way, its coords go to the end of the shared buffer
+    std::size_t begin = way_coord_buffer.size();
+    way_coord_buffer.insert(way_coord_buffer.end(), coords.begin(), coords.end());
+    way_coord_offsets.resize(way_coord_buffer.size());
+    polyline_offsets(&way_coord_buffer[begin], coords.size(), &way_coord_offsets[begin]);
+    Way new_way(id, begin, coords.size(), way_coord_offsets.back());
+
+    //hook the way up to the crossroads at both of its ends
+    int way_index = ways_vector.size();
+    new_way.start_ver = add_crossroad(coords.front());
+    new_way.end_ver = add_crossroad(coords.back());
+    crossroads_vector[new_way.start_ver].way_indexes.push_back(way_index);
+    if (new_way.end_ver != new_way.start_ver) {
+        crossroads_vector[new_way.end_ver].way_indexes.push_back(way_index);
     }
-    else if (ways_vector.size() > 1) {
-        new_way.prev = &ways_vector.back();
-    }
-    new_way.next = nullptr;
+    wayID_index_map.insert({id, way_index});
+    routing_changed();
+
     ways_vector.push_back(new_way);
-    for (unsigned long i = 0; i < ways_vector.size()-1; ++i) {
-        ways_vector.at(i).next = &ways_vector.at(i)+1;
+    landmarks_way_added(way_index);
+    if (!components_stale) {
+        crossroad_components.grow(crossroads_vector.size());
+        crossroad_components.unite(new_way.start_ver, new_way.end_ver);
     }
+    route_cache_way_added(way_index);
 
 
 
     return true;
 }
 
-//makes nodes for our pathfinding graph, I hope.
-
-bool Datastructures::make_node(Coord pos, Coord next)
+std::vector<std::pair<WayID, Coord>> Datastructures::ways_from(Coord xy)
 {
+    //only the ends of ways count, so the crossroad at xy already knows its ways
+    int crossroad = crossroad_id(xy);
+    if (crossroad < 0) {
+        return {};
+    }
 
-    bool next_exists = false;
-    int next_index;
-    //if node with given POS already exists return false
+    std::vector<std::pair<WayID, Coord>> ways_from_vect;
+    for (int way_index : crossroads_vector[crossroad].way_indexes) {
+        Way const& way = ways_vector[way_index];
+        int other = way.start_ver == crossroad ? way.end_ver : way.start_ver;
+        ways_from_vect.push_back(std::make_pair(way.id, crossroads_vector[other].position));
+    }
+    return ways_from_vect;
+}
+
+std::vector<Coord> Datastructures::get_way_coords(WayID id)
+{
+    // Finds a way with parameter WayID and returns it's coords.
+    // IF they can't be found, returns NO_COORD.
+    auto iter = wayID_index_map.find(id);
+    if (iter == wayID_index_map.end()) {
+        return {NO_COORD};
+    }
+    Way const& way = ways_vector[iter->second];
+    Coord const* coords = coords_of(way);
+    return std::vector<Coord>(coords, coords + way.coords_count);
+}
 
+void Datastructures::clear_ways()
+{
+    //clears the ways-vector and the crossroad graph built from it.
+    ways_vector.clear();
+    way_coord_buffer.clear();
+    way_coord_offsets.clear();
+    way_coord_holes = 0;
+    wayID_index_map.clear();
+    coord_crossroad_map.clear();
+    crossroads_vector.clear();
+    routing_changed();
+    crossroad_components.reset(0);
+    components_stale = false;
+    landmarks.clear();
+    landmark_dist.clear();
+    landmarks_stale = false;
+    trimmed_way_ids.clear();
+    trimmed_total = 0;
+}
 
-    for (unsigned long i = 0; i < nodes_vector.size(); ++i) {
-        if (nodes_vector.at(i).position == next) {
-            next_exists = true;
-            next_index = i;
+bool Datastructures::save_snapshot(std::string const& filename)
+{
+    Snapshot_header header = {};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+
+    std::vector<std::int64_t> place_ids;
+    std::vector<std::int32_t> place_types;
+    std::vector<std::int32_t> place_coords;
+    std::vector<std::uint64_t> place_names = {0};
+    std::vector<std::int64_t> area_ids;
+    std::vector<std::uint64_t> area_names;
+    std::vector<std::uint64_t> area_coords;
+    std::vector<std::int64_t> subarea_ids;
+    std::vector<std::int64_t> subarea_parents;
+    std::vector<std::uint64_t> way_ids;
+    std::vector<std::uint64_t> way_coords;
+    std::vector<std::int32_t> way_lengths;
+    std::vector<std::int32_t> coords;
+    std::string strings;
+
+    for (auto const& [id, name] : placeID_names_map) {
+        Coord xy = placeID_coord_map[id];
+        place_ids.push_back(id);
+        place_types.push_back(static_cast<std::int32_t>(placeID_type_map[id]));
+        place_coords.insert(place_coords.end(), {xy.x, xy.y});
+        strings += name;
+        place_names.push_back(strings.size());
+    }
+    //names and ids share the string table and areas and ways the coord table, so each
+    //offset array starts where the previous section ended
+    area_names.push_back(strings.size());
+    area_coords.push_back(coords.size() / 2);
+    for (auto const& [id, name] : areaID_name_map) {
+        area_ids.push_back(id);
+        strings += name;
+        area_names.push_back(strings.size());
+        for (Coord const& xy : areaID_coord_map[id]) {
+            coords.insert(coords.end(), {xy.x, xy.y});
         }
-        if (nodes_vector.at(i).position == pos) {
-            return false;
+        area_coords.push_back(coords.size() / 2);
+    }
+    for (auto const& [id, parent] : areaID_subarea_map) {
+        subarea_ids.push_back(id);
+        subarea_parents.push_back(parent);
+    }
+    way_ids.push_back(strings.size());
+    way_coords.push_back(coords.size() / 2);
+    for (Way const& way : ways_vector) {
+        strings += way.id;
+        way_ids.push_back(strings.size());
+        Coord const* way_coords_begin = coords_of(way);
+        for (Coord const* xy = way_coords_begin; xy != way_coords_begin + way.coords_count; ++xy) {
+            coords.insert(coords.end(), {xy->x, xy->y});
         }
+        way_coords.push_back(coords.size() / 2);
+        way_lengths.push_back(way.waylength);
     }
-    //else we add the new node
-    Way_node new_node;
-    new_node.position = pos;
-    new_node.prev = nullptr;
-    new_node.next = nullptr;
-    if (next_exists) {
-        new_node.next = &nodes_vector.at(next_index);
-        nodes_vector.at(next_index).prev = &new_node;
+
+    header.counts[SNAP_PLACES] = place_ids.size();
+    header.counts[SNAP_AREAS] = area_ids.size();
+    header.counts[SNAP_SUBAREAS] = subarea_ids.size();
+    header.counts[SNAP_WAYS] = ways_vector.size();
+    header.counts[SNAP_COORD_COUNT] = coords.size() / 2;
+    header.counts[SNAP_STRING_BYTES] = strings.size();
+
+    char const* blocks[SNAP_BLOCK_COUNT] = {};
+    auto set_block = [&](Snapshot_block block, void const* data, std::size_t bytes) {
+        blocks[block] = static_cast<char const*>(data);
+        header.block_size[block] = bytes;
+    };
+    set_block(SNAP_PLACE_IDS, place_ids.data(), place_ids.size() * sizeof(std::int64_t));
+    set_block(SNAP_PLACE_TYPES, place_types.data(), place_types.size() * sizeof(std::int32_t));
+    set_block(SNAP_PLACE_COORDS, place_coords.data(), place_coords.size() * sizeof(std::int32_t));
+    set_block(SNAP_PLACE_NAMES, place_names.data(), place_names.size() * sizeof(std::uint64_t));
+    set_block(SNAP_AREA_IDS, area_ids.data(), area_ids.size() * sizeof(std::int64_t));
+    set_block(SNAP_AREA_NAMES, area_names.data(), area_names.size() * sizeof(std::uint64_t));
+    set_block(SNAP_AREA_COORDS, area_coords.data(), area_coords.size() * sizeof(std::uint64_t));
+    set_block(SNAP_SUBAREA_IDS, subarea_ids.data(), subarea_ids.size() * sizeof(std::int64_t));
+    set_block(SNAP_SUBAREA_PARENTS, subarea_parents.data(), subarea_parents.size() * sizeof(std::int64_t));
+    set_block(SNAP_WAY_IDS, way_ids.data(), way_ids.size() * sizeof(std::uint64_t));
+    set_block(SNAP_WAY_COORDS, way_coords.data(), way_coords.size() * sizeof(std::uint64_t));
+    set_block(SNAP_WAY_LENGTHS, way_lengths.data(), way_lengths.size() * sizeof(std::int32_t));
+    set_block(SNAP_COORDS, coords.data(), coords.size() * sizeof(std::int32_t));
+    set_block(SNAP_STRINGS, strings.data(), strings.size());
+
+    //every block starts at a multiple of 8 so that the loader can use it in place
+    std::uint64_t offset = (sizeof(Snapshot_header) + 7) / 8 * 8;
+    for (int block = 0; block < SNAP_BLOCK_COUNT; ++block) {
+        header.block_offset[block] = offset;
+        offset += (header.block_size[block] + 7) / 8 * 8;
     }
-    nodes_vector.push_back(new_node);
-    return true;
+
+    std::ofstream output(filename, std::ios::binary | std::ios::trunc);
+    if (!output) {
+        return false;
+    }
+    char const padding[8] = {};
+    output.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    output.write(padding, header.block_offset[0] - sizeof(header));
+    for (int block = 0; block < SNAP_BLOCK_COUNT; ++block) {
+        std::uint64_t bytes = header.block_size[block];
+        if (bytes > 0) {
+            output.write(blocks[block], bytes);
+        }
+        output.write(padding, (8 - bytes % 8) % 8);
+    }
+    return static_cast<bool>(output);
 }
 
-std::vector<std::pair<WayID, Coord>> Datastructures::ways_from(Coord xy)
+bool Datastructures::load_snapshot(std::string const& filename)
 {
+    Mapped_file file(filename);
+    if (file.data() == nullptr || file.size() < sizeof(Snapshot_header)) {
+        return false;
+    }
+    Snapshot_header header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0
+        || header.version != SNAPSHOT_VERSION || header.byte_order != SNAPSHOT_BYTE_ORDER) {
+        return false;
+    }
 
-    std::vector<std::pair<WayID, Coord>> ways_from_vect;
-
-
-    //look through ways_vector to find given xy start coords
-    for (unsigned long i = 0; i < ways_vector.size(); ++i) {
-        for (unsigned long j = 0; j < ways_vector.at(i).way_coords_vect.size(); ++j) {
-            if (ways_vector.at(i).way_coords_vect[j] == xy) {
-                //if found, make pairs of ID's and coords
-                //if xy is at the end of way_coords_vect, we use the starting coords instead.
-                if (j == ways_vector.at(i).way_coords_vect.size()-1) {
-                    ways_from_vect.push_back(std::make_pair
-                                             (ways_vector.at(i).id, ways_vector.at(i).way_coords_vect[0]));
-                }
-                else {
-                    //otherwise we can use the last coords.
-                    ways_from_vect.push_back(std::make_pair
-                                             (ways_vector.at(i).id, ways_vector.at(i).way_coords_vect.back()));
-                }
+    //check every block against the file and the counts before touching anything. No element
+    //is smaller than 8 bytes except the string bytes, so a bigger count can't fit in the
+    //file and would only overflow the sizes below.
+    std::uint64_t const* counts = header.counts;
+    for (int count = 0; count < SNAP_COUNT_COUNT; ++count) {
+        if (counts[count] > (count == SNAP_STRING_BYTES ? file.size() : file.size() / 8)) {
+            return false;
+        }
+    }
+    std::uint64_t const expected_size[SNAP_BLOCK_COUNT] = {
+        counts[SNAP_PLACES] * 8, counts[SNAP_PLACES] * 4, counts[SNAP_PLACES] * 8, (counts[SNAP_PLACES] + 1) * 8,
+        counts[SNAP_AREAS] * 8, (counts[SNAP_AREAS] + 1) * 8, (counts[SNAP_AREAS] + 1) * 8,
+        counts[SNAP_SUBAREAS] * 8, counts[SNAP_SUBAREAS] * 8,
+        (counts[SNAP_WAYS] + 1) * 8, (counts[SNAP_WAYS] + 1) * 8, counts[SNAP_WAYS] * 4,
+        counts[SNAP_COORD_COUNT] * 8, counts[SNAP_STRING_BYTES]
+    };
+    for (int block = 0; block < SNAP_BLOCK_COUNT; ++block) {
+        if (header.block_size[block] != expected_size[block] || header.block_offset[block] % 8 != 0
+            || header.block_offset[block] > file.size() || header.block_size[block] > file.size() - header.block_offset[block]) {
+            return false;
+        }
+    }
+    auto column = [&](Snapshot_block block) { return file.data() + header.block_offset[block]; };
+    auto const* place_ids = reinterpret_cast<std::int64_t const*>(column(SNAP_PLACE_IDS));
+    auto const* place_types = reinterpret_cast<std::int32_t const*>(column(SNAP_PLACE_TYPES));
+    auto const* place_coords = reinterpret_cast<std::int32_t const*>(column(SNAP_PLACE_COORDS));
+    auto const* place_names = reinterpret_cast<std::uint64_t const*>(column(SNAP_PLACE_NAMES));
+    auto const* area_ids = reinterpret_cast<std::int64_t const*>(column(SNAP_AREA_IDS));
+    auto const* area_names = reinterpret_cast<std::uint64_t const*>(column(SNAP_AREA_NAMES));
+    auto const* area_coords = reinterpret_cast<std::uint64_t const*>(column(SNAP_AREA_COORDS));
+    auto const* subarea_ids = reinterpret_cast<std::int64_t const*>(column(SNAP_SUBAREA_IDS));
+    auto const* subarea_parents = reinterpret_cast<std::int64_t const*>(column(SNAP_SUBAREA_PARENTS));
+    auto const* way_ids = reinterpret_cast<std::uint64_t const*>(column(SNAP_WAY_IDS));
+    auto const* way_coords = reinterpret_cast<std::uint64_t const*>(column(SNAP_WAY_COORDS));
+    auto const* coords = reinterpret_cast<std::int32_t const*>(column(SNAP_COORDS));
+    char const* strings = column(SNAP_STRINGS);
+
+    //offset arrays have to grow and stay inside their tables. They needn't start at 0,
+    //the tables are shared between sections.
+    auto valid_offsets = [](std::uint64_t const* offsets, std::uint64_t count, std::uint64_t limit) {
+        for (std::uint64_t i = 0; i < count; ++i) {
+            if (offsets[i] > offsets[i+1]) {
+                return false;
             }
         }
+        return offsets[count] <= limit;
+    };
+    if (!valid_offsets(place_names, counts[SNAP_PLACES], counts[SNAP_STRING_BYTES])
+        || !valid_offsets(area_names, counts[SNAP_AREAS], counts[SNAP_STRING_BYTES])
+        || !valid_offsets(area_coords, counts[SNAP_AREAS], counts[SNAP_COORD_COUNT])
+        || !valid_offsets(way_ids, counts[SNAP_WAYS], counts[SNAP_STRING_BYTES])
+        || !valid_offsets(way_coords, counts[SNAP_WAYS], counts[SNAP_COORD_COUNT])) {
+        return false;
     }
-
-    //if we haven't found anything, return NO_WAY, NO_COORD
-    if (ways_from_vect.size() == 0) {
-        return {};
+    //every way needs at least one coord to have crossroads at its ends
+    for (std::uint64_t i = 0; i < counts[SNAP_WAYS]; ++i) {
+        if (way_coords[i] == way_coords[i+1]) {
+            return false;
+        }
+    }
+    for (std::uint64_t i = 0; i < counts[SNAP_PLACES]; ++i) {
+        if (place_types[i] < static_cast<std::int32_t>(PlaceType::OTHER)
+            || place_types[i] > static_cast<std::int32_t>(PlaceType::NO_TYPE)) {
+            return false;
+        }
     }
-    //otherwise we return the results.
-    return ways_from_vect;
-}
 
-std::vector<Coord> Datastructures::get_way_coords(WayID id)
-{
-    // Finds a way with parameter WayID and returns it's coords.
-    // IF they can't be found, returns NO_COORD.
+    placeID_names_map.clear();
+    placeID_type_map.clear();
+    placeID_coord_map.clear();
+    placeID_names_map.reserve(counts[SNAP_PLACES]);
+    placeID_type_map.reserve(counts[SNAP_PLACES]);
+    placeID_coord_map.reserve(counts[SNAP_PLACES]);
+    place_snaps.clear();
+    place_snaps_epoch = std::numeric_limits<unsigned long int>::max();
+    for (std::uint64_t i = 0; i < counts[SNAP_PLACES]; ++i) {
+        PlaceID id = place_ids[i];
+        placeID_names_map.emplace(id, Name(strings + place_names[i], place_names[i+1] - place_names[i]));
+        placeID_type_map.emplace(id, static_cast<PlaceType>(place_types[i]));
+        placeID_coord_map.emplace(id, Coord{place_coords[2*i], place_coords[2*i+1]});
+    }
 
-    std::vector<Coord> get_way_coords_vect;
+    areaID_name_map.clear();
+    areaID_coord_map.clear();
+    areaID_subarea_map.clear();
+    areaID_name_map.reserve(counts[SNAP_AREAS]);
+    areaID_coord_map.reserve(counts[SNAP_AREAS]);
+    for (std::uint64_t i = 0; i < counts[SNAP_AREAS]; ++i) {
+        AreaID id = area_ids[i];
+        areaID_name_map.emplace(id, Name(strings + area_names[i], area_names[i+1] - area_names[i]));
+        std::vector<Coord>& area = areaID_coord_map[id];
+        area.reserve(area_coords[i+1] - area_coords[i]);
+        for (std::uint64_t c = area_coords[i]; c < area_coords[i+1]; ++c) {
+            area.push_back({coords[2*c], coords[2*c+1]});
+        }
+    }
+    areaID_subarea_map.reserve(counts[SNAP_SUBAREAS]);
+    for (std::uint64_t i = 0; i < counts[SNAP_SUBAREAS]; ++i) {
+        areaID_subarea_map.emplace(subarea_ids[i], subarea_parents[i]);
+    }
 
-    //if we find a way with the given ID, copy it's way_coords to our return vector
-    for (unsigned long i = 0; i < ways_vector.size(); ++i) {
-        if (ways_vector.at(i).id == id) {
-            get_way_coords_vect = ways_vector.at(i).way_coords_vect;
-            return get_way_coords_vect;
+    //the ways go straight into ways_vector, the crossroads are then built in one pass
+    clear_ways();
+    ways_vector.resize(counts[SNAP_WAYS]);
+    wayID_index_map.reserve(counts[SNAP_WAYS]);
+    way_coord_buffer.reserve(way_coords[counts[SNAP_WAYS]] - way_coords[0]);
+    for (std::uint64_t i = 0; i < counts[SNAP_WAYS]; ++i) {
+        Way& way = ways_vector[i];
+        way.id.assign(strings + way_ids[i], way_ids[i+1] - way_ids[i]);
+        way.coords_begin = way_coord_buffer.size();
+        way.coords_count = way_coords[i+1] - way_coords[i];
+        for (std::uint64_t c = way_coords[i]; c < way_coords[i+1]; ++c) {
+            way_coord_buffer.push_back({coords[2*c], coords[2*c+1]});
+        }
+    }
+    //segment lengths of the whole buffer in one go, then each way sums its own. The lengths
+    //across way boundaries are computed too but get overwritten by the 0 at each way start.
+    way_coord_offsets.resize(way_coord_buffer.size());
+    if (!way_coord_buffer.empty()) {
+        segment_lengths(way_coord_buffer.data(), way_coord_buffer.size() - 1, way_coord_offsets.data() + 1);
+    }
+    for (Way& way : ways_vector) {
+        Distance* offsets = &way_coord_offsets[way.coords_begin];
+        offsets[0] = 0;
+        for (std::size_t c = 1; c < way.coords_count; ++c) {
+            offsets[c] += offsets[c-1];
         }
+        way.waylength = offsets[way.coords_count - 1];
     }
-    //otherwise we just return the NO_COORD.
-    return {NO_COORD};
+    rebuild_way_graph();
+    return true;
 }
 
-void Datastructures::clear_ways()
+std::vector<std::tuple<Coord, WayID, Distance> > Datastructures::route_any(Coord fromxy, Coord toxy)
 {
-    //clears the ways-vector.
-    ways_vector.clear();
+    if (disconnected(fromxy, toxy)) {
+        return {};
+    }
+    Route_cache_key key = {RouteKind::ANY, fromxy, toxy};
+    if (auto cached = cached_route(key)) {
+        return *cached;
+    }
+    //the fewest crossroads is as good an answer as any
+    auto result = find_route_least_crossroads(fromxy, toxy, route_scratch);
+    remember_route(key, result);
+    return result;
 }
 
-std::vector<std::tuple<Coord, WayID, Distance> > Datastructures::route_any(Coord fromxy, Coord toxy)
+bool Datastructures::remove_way(WayID id)
 {
-    // Replace this comment with your implementation
+    auto iter = wayID_index_map.find(id);
+    if (iter == wayID_index_map.end()) {
+        return false;
+    }
+    int way_index = iter->second;
+    wayID_index_map.erase(iter);
+    int ends[2] = {ways_vector[way_index].start_ver, ways_vector[way_index].end_ver};
+    Coord end_coords[2] = {crossroads_vector[ends[0]].position, crossroads_vector[ends[1]].position};
+    Distance length = ways_vector[way_index].waylength;
+    way_coord_holes += ways_vector[way_index].coords_count;
+
+    //unlink the way from its crossroads
+    for (int side = 0; side < 2; ++side) {
+        std::vector<int>& ways = crossroads_vector[ends[side]].way_indexes;
+        auto found = std::find(ways.begin(), ways.end(), way_index);
+        if (found != ways.end()) {
+            *found = ways.back();
+            ways.pop_back();
+        }
+    }
 
-    std::vector<std::tuple<Coord, WayID, Distance>> tuple = route(fromxy, toxy);
+    //move the last way into the hole and point its crossroads at the new index
+    int last = ways_vector.size() - 1;
+    if (way_index != last) {
+        ways_vector[way_index] = std::move(ways_vector[last]);
+        Way const& moved = ways_vector[way_index];
+        wayID_index_map[moved.id] = way_index;
+        for (int crossroad : {moved.start_ver, moved.end_ver}) {
+            std::vector<int>& ways = crossroads_vector[crossroad].way_indexes;
+            std::replace(ways.begin(), ways.end(), last, way_index);
+        }
+    }
+    ways_vector.pop_back();
+    //once half the coord buffer is holes it gets compacted, that keeps removals amortized O(1)
+    if (2 * way_coord_holes > way_coord_buffer.size()) {
+        compact_way_coords();
+    }
+    //distances can only grow, and only behind the removed way
+    landmarks_way_removed(ends[0], ends[1], length);
 
-    return tuple;
+    //higher id first, removing it can't move the lower one
+    if (ends[0] < ends[1]) {
+        std::swap(ends[0], ends[1]);
+    }
+    for (int side = 0; side < 2; ++side) {
+        if (crossroads_vector[ends[side]].way_indexes.empty()) {
+            remove_crossroad(ends[side]);
+            if (ends[0] == ends[1]) {
+                break;
+            }
+        }
+    }
 
+    routing_changed();
+    route_cache_way_removed(id, end_coords[0], end_coords[1]);
+    //a union-find can't split a component, so the labels are recomputed when needed
+    components_stale = true;
+    return true;
 }
 
-bool Datastructures::remove_way(WayID id)
+std::vector<std::tuple<Coord, WayID, Distance> > Datastructures::route_least_crossroads(Coord fromxy, Coord toxy)
 {
-    // Replace this comment with your implementation
-    return false;
+    if (disconnected(fromxy, toxy)) {
+        return {};
+    }
+    Route_cache_key key = {RouteKind::LEAST_CROSSROADS, fromxy, toxy};
+    if (auto cached = cached_route(key)) {
+        return *cached;
+    }
+    auto result = find_route_least_crossroads(fromxy, toxy, route_scratch);
+    remember_route(key, result);
+    return result;
 }
 
-std::vector<std::tuple<Coord, WayID, Distance> > Datastructures::route_least_crossroads(Coord fromxy, Coord toxy)
+std::vector<std::tuple<Coord, WayID, Distance>> Datastructures::find_route_least_crossroads(Coord fromxy, Coord toxy,
+                                                                                      Route_scratch& scratch) const
 {
-    // Replace this comment with your implementation
-    return {{NO_COORD, NO_WAY, NO_DISTANCE}};
+    int from = crossroad_id(fromxy);
+    int to = crossroad_id(toxy);
+    if (from < 0 || to < 0) {
+        return {{NO_COORD, NO_WAY, NO_DISTANCE}};
+    }
+
+    scratch.next_query(crossroads_vector.size());
+    int meet;
+    if (route_search == RouteSearch::BIDIRECTIONAL) {
+        meet = bfs_route_bidirectional(from, to, scratch);
+    }
+    else {
+        meet = bfs_route(from, to, scratch);
+    }
+    if (meet < 0) {
+        return {};
+    }
+    return build_route(from, meet, to, scratch);
 }
 
 std::vector<std::tuple<Coord, WayID> > Datastructures::route_with_cycle(Coord fromxy)
 {
-    // Replace this comment with your implementation
-    return {{NO_COORD, NO_WAY}};
+    int from = crossroad_id(fromxy);
+    if (from < 0) {
+        return {{NO_COORD, NO_WAY}};
+    }
+
+    //iterative DFS, seen[0] marks discovered (grey) and seen[1] finished (black)
+    //crossroads. The stack holds the current path and where each crossroad is at in
+    //going through its ways, so a million-way chain can't overflow anything.
+    route_scratch.next_query(crossroads_vector.size());
+    unsigned int stamp = route_scratch.stamp;
+    std::vector<unsigned int>& discovered = route_scratch.seen[0];
+    std::vector<unsigned int>& finished = route_scratch.seen[1];
+    std::vector<int>& parent_way = route_scratch.parent_way[0];
+    std::vector<std::pair<int, std::size_t>>& stack = route_scratch.dfs_stack;
+
+    stack.clear();
+    stack.push_back({from, 0});
+    discovered[from] = stamp;
+    parent_way[from] = -1;
+
+    while (!stack.empty()) {
+        int current = stack.back().first;
+        std::vector<int> const& ways = crossroads_vector[current].way_indexes;
+        if (stack.back().second == ways.size()) {
+            finished[current] = stamp;
+            stack.pop_back();
+            continue;
+        }
+        int way_index = ways[stack.back().second++];
+        if (way_index == parent_way[current]) {
+            continue;
+        }
+        int next = other_end(way_index, current);
+        if (discovered[next] != stamp) {
+            discovered[next] = stamp;
+            parent_way[next] = way_index;
+            stack.push_back({next, 0});
+        }
+        else if (finished[next] != stamp) {
+            //way back to a crossroad on the stack: the stack is the route to the cycle
+            std::vector<std::tuple<Coord, WayID>> result;
+            result.reserve(stack.size() + 1);
+            for (std::size_t i = 0; i + 1 < stack.size(); ++i) {
+                result.emplace_back(crossroads_vector[stack[i].first].position,
+                                    ways_vector[parent_way[stack[i+1].first]].id);
+            }
+            result.emplace_back(crossroads_vector[current].position, ways_vector[way_index].id);
+            result.emplace_back(crossroads_vector[next].position, NO_WAY);
+            return result;
+        }
+    }
+    return {};
 }
 
 std::vector<std::tuple<Coord, WayID, Distance> > Datastructures::route_shortest_distance(Coord fromxy, Coord toxy)
 {
-    // Replace this comment with your implementation
-    return {{NO_COORD, NO_WAY, NO_DISTANCE}};
+    if (disconnected(fromxy, toxy)) {
+        return {};
+    }
+    Route_cache_key key = {RouteKind::SHORTEST_DISTANCE, fromxy, toxy};
+    if (auto cached = cached_route(key)) {
+        return *cached;
+    }
+    if (landmarks_stale) {
+        rebuild_landmark_tables();
+    }
+    if (chain_compression && chains_stale) {
+        rebuild_chains();
+    }
+    auto result = find_route_shortest_distance(fromxy, toxy, route_scratch);
+    remember_route(key, result);
+    return result;
 }
 
-Distance Datastructures::trim_ways()
+std::vector<std::tuple<Coord, WayID, Distance>> Datastructures::find_route_shortest_distance(Coord fromxy, Coord toxy,
+                                                                                       Route_scratch& scratch) const
 {
-    // Replace this comment with your implementation
-    return NO_DISTANCE;
-}
-
+    int from = crossroad_id(fromxy);
+    int to = crossroad_id(toxy);
+    if (from < 0 || to < 0) {
+        return {{NO_COORD, NO_WAY, NO_DISTANCE}};
+    }
 
-std::pair<WayID, int> Datastructures::get_shortest_way(std::vector<Datastructures::Way> ways)
-{
-    int shortest = 999999;
-    WayID shortest_id = 0;
-    for (unsigned long i = 0; i < ways.size(); ++i) {
-        if (ways.at(i).waylength < shortest) {
-            shortest = ways.at(i).waylength;
-            shortest_id = ways.at(i).id;
+    scratch.next_query(crossroads_vector.size());
+    if (ch_ready) {
+        int meet = ch_route(from, to, scratch);
+        if (meet < 0) {
+            return {};
+        }
+        //collect the hierarchy edges of both halves, then expand the shortcuts on them
+        std::vector<int>& edges = scratch.edge_path;
+        edges.clear();
+        for (int node = meet; node != from; ) {
+            int edge = scratch.parent_way[0][node];
+            node = ch_edges[edge].ends[0] == node ? ch_edges[edge].ends[1] : ch_edges[edge].ends[0];
+            edges.push_back(edge);
+        }
+        std::reverse(edges.begin(), edges.end());
+        for (int node = meet; node != to; ) {
+            int edge = scratch.parent_way[1][node];
+            edges.push_back(edge);
+            node = ch_edges[edge].ends[0] == node ? ch_edges[edge].ends[1] : ch_edges[edge].ends[0];
+        }
+        scratch.way_path.clear();
+        int node = from;
+        for (int edge : edges) {
+            unpack_ch_edge(edge, node, scratch);
+            node = ch_edges[edge].ends[0] == node ? ch_edges[edge].ends[1] : ch_edges[edge].ends[0];
+        }
+        return build_route_from_ways(from, scratch.way_path);
+    }
+    if (landmarks.empty() && chain_compression) {
+        if (!chain_route(from, to, scratch)) {
+            return {};
         }
+        return build_route_from_ways(from, scratch.way_path);
+    }
+    int meet;
+    if (!landmarks.empty()) {
+        meet = astar_route(from, to, scratch);
+    }
+    else if (route_search == RouteSearch::BIDIRECTIONAL) {
+        meet = dijkstra_route_bidirectional(from, to, scratch);
+    }
+    else {
+        meet = dijkstra_route(from, to, scratch);
+    }
+    if (meet < 0) {
+        return {};
     }
-    std::pair<WayID, int> pair;
-    pair = std::make_pair(shortest_id, shortest);
-    return pair;
+    return build_route(from, meet, to, scratch);
 }
 
-int Datastructures:: get_node_index(Coord pos)
+std::vector<std::vector<std::tuple<Coord, WayID, Distance>>> Datastructures::route_batch(std::vector<std::pair<Coord, Coord>> queries,
+                                                                                          RouteKind kind)
 {
-    for (unsigned long i = 0; i < nodes_vector.size(); ++i) {
-        if (nodes_vector.at(i).position == pos) {
-            return i;
-        }
+    //the searches only read the graph, so anything built lazily has to be ready before they start
+    if (kind == RouteKind::SHORTEST_DISTANCE && landmarks_stale) {
+        rebuild_landmark_tables();
+    }
+    if (kind == RouteKind::SHORTEST_DISTANCE && chain_compression && chains_stale) {
+        rebuild_chains();
+    }
+    std::vector<std::vector<std::tuple<Coord, WayID, Distance>>> results(queries.size());
+    std::vector<bool> skip(queries.size());
+    for (std::size_t i = 0; i < queries.size(); ++i) {
+        skip[i] = disconnected(queries[i].first, queries[i].second);
     }
-    return false;
-}
 
+    //route lengths vary a lot, so the workers take the next query from a shared counter
+    //instead of getting a fixed share of them
+    std::atomic<std::size_t> next_query(0);
+    auto worker = [&]() {
+        Route_scratch scratch;
+        for (std::size_t i = next_query++; i < queries.size(); i = next_query++) {
+            auto [fromxy, toxy] = queries[i];
+            if (skip[i]) {
+                continue;
+            }
+            if (kind == RouteKind::SHORTEST_DISTANCE) {
+                results[i] = find_route_shortest_distance(fromxy, toxy, scratch);
+            }
+            else {
+                results[i] = find_route_least_crossroads(fromxy, toxy, scratch);
+            }
+        }
+    };
 
+    unsigned int threads = std::max<std::size_t>(1, std::min<std::size_t>(thread_count(), queries.size()));
+    std::vector<std::thread> workers;
+    for (unsigned int t = 1; t < threads; ++t) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+    return results;
+}
 
-std::string Datastructures::find_way(Coord pos, std::vector<Way> ways_vector)
+std::tuple<Coord, WayID, Distance> Datastructures::snap_to_way(Coord xy)
 {
-    for (unsigned long i = 0; i < ways_vector.size(); ++i) {
-        if (ways_vector.at(i).start == pos) {
-            return ways_vector.at(i).id;
-        }
+    if (segments_stale) {
+        rebuild_segment_index();
     }
-    return NO_WAY;
+    if (way_segments.empty()) {
+        return {NO_COORD, NO_WAY, NO_DISTANCE};
+    }
+    Snap_point point = snap(xy);
+    Way const& way = ways_vector[point.way_index];
+    Distance offset = point.offset;
+    if (point.crossroad >= 0) {
+        offset = point.crossroad == way.start_ver ? 0 : way.waylength;
+    }
+    return {point.xy, way.id, offset};
 }
 
-int Datastructures::find_way_distance(Coord pos)
+std::vector<std::tuple<Coord, WayID, Distance>> Datastructures::route_between_points(Coord fromxy, Coord toxy)
 {
-    for (unsigned long i = 0; i < ways_vector.size(); ++i) {
-        if (ways_vector.at(i).start == pos) {
-            return ways_vector.at(i).waylength;
-        }
+    if (segments_stale) {
+        rebuild_segment_index();
     }
-    return 0;
+    if (way_segments.empty()) {
+        return {{NO_COORD, NO_WAY, NO_DISTANCE}};
+    }
+    Snap_point from = snap(fromxy);
+    Snap_point to = snap(toxy);
+    int from_crossroad = from.crossroad >= 0 ? from.crossroad : ways_vector[from.way_index].start_ver;
+    int to_crossroad = to.crossroad >= 0 ? to.crossroad : ways_vector[to.way_index].start_ver;
+    if (from.way_index != to.way_index && disconnected(crossroads_vector[from_crossroad].position,
+                                                      crossroads_vector[to_crossroad].position)) {
+        return {};
+    }
+    route_scratch.next_query(crossroads_vector.size());
+    return snapped_route(from, to, route_scratch);
 }
 
-std::vector<std::tuple<Coord, WayID, Distance>> Datastructures::route(Coord fromxy, Coord toxy)
+std::vector<std::tuple<Coord, WayID, Distance>> Datastructures::route_between_places(PlaceID fromid, PlaceID toid,
+                                                                                    RouteKind kind)
 {
-    std::vector<Distance> distances;
-    std::vector<Distance> distances_to_be_returned;
-    std::vector<Way> to_be_visited = ways_vector;
-    std::vector<WayID> visited;
-    std::vector<Coord> visited_coords;
-
-    Way current;
-    Way end;
-
-    for (unsigned long i = 0; i < to_be_visited.size(); ++i) {
-        if (to_be_visited.at(i).end_coord == fromxy) {
-            current = ways_vector.at(i);
-        }
-        if (to_be_visited.at(i).end_coord == toxy) {
-            end = to_be_visited.at(i);
-        }
-
+    if (placeID_coord_map.count(fromid) == 0 || placeID_coord_map.count(toid) == 0) {
+        return {{NO_COORD, NO_WAY, NO_DISTANCE}};
+    }
+    Snap_point const* from_snap = place_snap(fromid);
+    Snap_point const* to_snap = place_snap(toid);
+    if (from_snap == nullptr || to_snap == nullptr) {
+        return {{NO_COORD, NO_WAY, NO_DISTANCE}};
+    }
+    Snap_point from = *from_snap;
+    Snap_point to = *to_snap;
+    Way const& from_way = ways_vector[from.way_index];
+    Way const& to_way = ways_vector[to.way_index];
+    int from_crossroad = from.crossroad >= 0 ? from.crossroad : from_way.start_ver;
+    int to_crossroad = to.crossroad >= 0 ? to.crossroad : to_way.start_ver;
+    if (from.way_index != to.way_index && disconnected(crossroads_vector[from_crossroad].position,
+                                                      crossroads_vector[to_crossroad].position)) {
+        return {};
+    }
+    if (kind == RouteKind::SHORTEST_DISTANCE) {
+        route_scratch.next_query(crossroads_vector.size());
+        return snapped_route(from, to, route_scratch);
     }
 
-    //check if either start or end coord has no ways, return  {NO_COORD, NO_WAY, NO_DISTANCE}
-
-    if (current.endnode == nullptr || end.startnode == nullptr) {
-        std::vector<std::tuple<Coord, WayID, Distance>> fail;
-        fail.push_back(std::make_tuple(NO_COORD, NO_WAY, NO_DISTANCE));
-        return fail;
+    //the other kinds count crossroads, so they go from and to the nearer end of the ways
+    Distance from_part = 0;
+    Distance to_part = 0;
+    if (from.crossroad < 0) {
+        bool to_start = from.offset <= from_way.waylength - from.offset;
+        from_crossroad = to_start ? from_way.start_ver : from_way.end_ver;
+        from_part = to_start ? from.offset : from_way.waylength - from.offset;
+    }
+    if (to.crossroad < 0) {
+        bool to_start = to.offset <= to_way.waylength - to.offset;
+        to_crossroad = to_start ? to_way.start_ver : to_way.end_ver;
+        to_part = to_start ? to.offset : to_way.waylength - to.offset;
+    }
+    Coord fromxy = crossroads_vector[from_crossroad].position;
+    Coord toxy = crossroads_vector[to_crossroad].position;
+    auto steps = kind == RouteKind::ANY ? route_any(fromxy, toxy) : route_least_crossroads(fromxy, toxy);
+    if (steps.empty()) {
+        return {};
     }
 
-    bool found = false;
-    std::queue<Way> q;
-    std::vector<Way> discovered;
-    Coord last;
-    discovered.push_back(current);
+    std::vector<std::tuple<Coord, WayID, Distance>> result;
+    if (from.crossroad < 0) {
+        result.emplace_back(from.xy, from_way.id, 0);
+    }
+    for (auto const& [xy, wayid, dist] : steps) {
+        result.emplace_back(xy, wayid, dist + from_part);
+    }
+    if (to.crossroad < 0) {
+        Distance total = std::get<2>(result.back());
+        std::get<1>(result.back()) = to_way.id;
+        result.emplace_back(to.xy, NO_WAY, total + to_part);
+    }
+    return result;
+}
 
-    q.push(current);
+std::vector<std::pair<PlaceID, Distance>> Datastructures::nearest_by_road(Coord fromxy, PlaceType type, int count)
+{
+    int from = crossroad_id(fromxy);
+    if (from < 0) {
+        return {{NO_PLACE, NO_DISTANCE}};
+    }
+    if (place_snaps_epoch != graph_epoch) {
+        attach_places();
+    }
+    if (count <= 0) {
+        return {};
+    }
 
-    while (found == false) {
-        Way v = q.front();
-        q.pop();
-        if (v.start == toxy) {
-            found = true;
+    //best known road distance of each place found so far. A place is final once the
+    //search has passed its distance, every other way to it would be longer.
+    std::unordered_map<PlaceID, Distance> found;
+    std::vector<std::pair<Distance, PlaceID>> result;
+
+    route_scratch.next_query(crossroads_vector.size());
+    unsigned int stamp = route_scratch.stamp;
+    std::vector<std::pair<Distance, int>>& heap = route_scratch.heap[0];
+    std::vector<Distance>& dist = route_scratch.dist[0];
+    auto heap_comp = std::greater<std::pair<Distance, int>>();
+    heap.clear();
+    route_scratch.seen[0][from] = stamp;
+    dist[from] = 0;
+    heap.push_back({0, from});
+
+    //places are settled from their own heap in distance order as the search passes them
+    std::vector<std::pair<Distance, PlaceID>> place_heap;
+    auto place_comp = std::greater<std::pair<Distance, PlaceID>>();
+    auto settle_places = [&](Distance limit) {
+        while (!place_heap.empty() && place_heap.front().first <= limit && static_cast<int>(result.size()) < count) {
+            std::pop_heap(place_heap.begin(), place_heap.end(), place_comp);
+            auto [place_dist, place] = place_heap.back();
+            place_heap.pop_back();
+            if (found[place] == place_dist && place_dist >= 0) {
+                result.push_back({place_dist, place});
+                found[place] = -1;
+            }
         }
-        while (current.next != nullptr || found == false) {
-            if (current.next != nullptr) {
-                current = *current.next;
-                if (current.end_coord == toxy) {
-                    last = current.end_coord;
-                    found = true;
-                }
-                discovered.push_back(current);
-                distances.push_back(current.waylength);
-                q.push(current);
-
+    };
+
+    while (!heap.empty() && static_cast<int>(result.size()) < count) {
+        std::pop_heap(heap.begin(), heap.end(), heap_comp);
+        auto [current_dist, current] = heap.back();
+        heap.pop_back();
+        if (current_dist > dist[current]) {
+            continue;
+        }
+        settle_places(current_dist);
+        for (auto const& [place, extra] : crossroad_places[current]) {
+            auto place_type = placeID_type_map.find(place);
+            if (place_type == placeID_type_map.end() || (type != PlaceType::NO_TYPE && place_type->second != type)) {
+                continue;
+            }
+            Distance place_dist = current_dist + extra;
+            auto iter = found.find(place);
+            if (iter == found.end() || (iter->second >= 0 && place_dist < iter->second)) {
+                found[place] = place_dist;
+                place_heap.push_back({place_dist, place});
+                std::push_heap(place_heap.begin(), place_heap.end(), place_comp);
+            }
+        }
+        for (int way_index : crossroads_vector[current].way_indexes) {
+            int next = other_end(way_index, current);
+            Distance next_dist = current_dist + ways_vector[way_index].waylength;
+            if (route_scratch.seen[0][next] != stamp || next_dist < dist[next]) {
+                route_scratch.seen[0][next] = stamp;
+                dist[next] = next_dist;
+                heap.push_back({next_dist, next});
+                std::push_heap(heap.begin(), heap.end(), heap_comp);
             }
         }
     }
+    //the whole component has been searched, whatever is left is final
+    settle_places(std::numeric_limits<Distance>::max());
 
-    Distance total = 0;
-
-    for(std::vector<Distance>::iterator it = distances.begin(); it != distances.end(); ++it) {
-        total += *it;
+    std::vector<std::pair<PlaceID, Distance>> nearest;
+    for (auto const& [place_dist, place] : result) {
+        nearest.push_back({place, place_dist});
     }
-    std::vector<std::tuple<Coord, WayID, Distance>> tuples;
+    return nearest;
+}
 
-    for (unsigned long i = 0; i < discovered.size()-1; ++i) {
-        tuples.push_back(std::make_tuple(discovered.at(i).start,
-                                         discovered.at(i).id, discovered.at(i).waylength));
+std::vector<std::vector<Distance>> Datastructures::distance_matrix(std::vector<Coord> sources, std::vector<Coord> targets)
+{
+    refresh_components();
+    std::vector<int> target_ids;
+    std::vector<int> target_components;
+    target_ids.reserve(targets.size());
+    for (Coord const& xy : targets) {
+        int target = crossroad_id(xy);
+        target_ids.push_back(target);
+        target_components.push_back(target >= 0 ? crossroad_components.find(target) : -1);
     }
-
-    tuples.push_back(std::make_tuple(last, NO_WAY, total));
-    return tuples;
+    std::vector<int> source_components;
+    for (Coord const& xy : sources) {
+        int source = crossroad_id(xy);
+        source_components.push_back(source >= 0 ? crossroad_components.find(source) : -1);
+    }
+    std::vector<std::vector<Distance>> matrix(sources.size(), std::vector<Distance>(targets.size(), NO_DISTANCE));
+
+    unsigned int threads = thread_count();
+    parallel_chunks(sources.size(), threads, [&](std::size_t begin, std::size_t end, unsigned int) {
+        //every thread needs its own search state, the member scratch is not shared
+        Route_scratch scratch;
+        std::vector<int> reachable_targets;
+        for (std::size_t i = begin; i < end; ++i) {
+            int from = crossroad_id(sources[i]);
+            if (from < 0) {
+                continue;
+            }
+            //targets in other components would keep the search going until it runs out
+            reachable_targets = target_ids;
+            for (std::size_t j = 0; j < targets.size(); ++j) {
+                if (target_components[j] != source_components[i]) {
+                    reachable_targets[j] = -1;
+                }
+            }
+            dijkstra_to_targets(from, reachable_targets, matrix[i], scratch);
+        }
+    });
+    return matrix;
 }
 
+std::vector<std::vector<std::tuple<Coord, WayID, Distance>>> Datastructures::route_alternatives(Coord fromxy, Coord toxy,
+                                                                                                 int count)
+{
+    int from = crossroad_id(fromxy);
+    int to = crossroad_id(toxy);
+    if (from < 0 || to < 0) {
+        return {{{NO_COORD, NO_WAY, NO_DISTANCE}}};
+    }
+    if (count <= 0 || disconnected(fromxy, toxy)) {
+        return {};
+    }
+
+    //routes are kept as way indexes from "from", with the index where they left the route
+    //they were spurred from
+    std::vector<std::vector<int>> routes;
+    std::vector<int> deviations;
+    std::set<std::tuple<Distance, std::vector<int>, int>> candidates;
+    std::set<std::vector<int>> known;
+    std::vector<int> blocked_ways;
 
+    route_scratch.next_query(crossroads_vector.size());
+    if (spur_dijkstra(from, to, blocked_ways, route_scratch) < 0) {
+        return {};
+    }
+    std::vector<int> first;
+    for (int node = to; node != from; node = other_end(route_scratch.parent_way[0][node], node)) {
+        first.push_back(route_scratch.parent_way[0][node]);
+    }
+    std::reverse(first.begin(), first.end());
+    known.insert(first);
+    routes.push_back(first);
+    deviations.push_back(0);
+
+    std::vector<int> nodes;
+    std::vector<Distance> root_length;
+    while (static_cast<int>(routes.size()) < count) {
+        std::vector<int> const& last = routes.back();
+        nodes.assign(1, from);
+        root_length.assign(1, 0);
+        for (int way_index : last) {
+            nodes.push_back(other_end(way_index, nodes.back()));
+            root_length.push_back(root_length.back() + ways_vector[way_index].waylength);
+        }
+
+        for (std::size_t spur = deviations.back(); spur < last.size(); ++spur) {
+            //the next way of every earlier route with the same beginning is taken already
+            blocked_ways.clear();
+            for (std::vector<int> const& route : routes) {
+                if (route.size() > spur && std::equal(last.begin(), last.begin() + spur, route.begin())) {
+                    blocked_ways.push_back(route[spur]);
+                }
+            }
+            //the beginning can't be visited again, that would make a loop
+            route_scratch.next_query(crossroads_vector.size());
+            for (std::size_t i = 0; i < spur; ++i) {
+                route_scratch.seen[1][nodes[i]] = route_scratch.stamp;
+            }
+            if (spur_dijkstra(nodes[spur], to, blocked_ways, route_scratch) < 0) {
+                continue;
+            }
+
+            std::vector<int> candidate(last.begin(), last.begin() + spur);
+            std::size_t root_end = candidate.size();
+            for (int node = to; node != nodes[spur]; node = other_end(route_scratch.parent_way[0][node], node)) {
+                candidate.push_back(route_scratch.parent_way[0][node]);
+            }
+            std::reverse(candidate.begin() + root_end, candidate.end());
+            if (known.insert(candidate).second) {
+                Distance length = root_length[spur] + route_scratch.dist[0][to];
+                candidates.insert({length, std::move(candidate), static_cast<int>(spur)});
+            }
+        }
+
+        if (candidates.empty()) {
+            break;
+        }
+        auto best = candidates.begin();
+        routes.push_back(std::get<1>(*best));
+        deviations.push_back(std::get<2>(*best));
+        candidates.erase(best);
+    }
+
+    std::vector<std::vector<std::tuple<Coord, WayID, Distance>>> result;
+    for (std::vector<int> const& route : routes) {
+        result.push_back(build_route_from_ways(from, route));
+    }
+    return result;
+}
+
+std::vector<std::pair<Coord, Distance>> Datastructures::reachable_within(Coord fromxy, Distance budget)
+{
+    int from = crossroad_id(fromxy);
+    if (from < 0 || budget < 0) {
+        return {};
+    }
+    std::vector<int> settled;
+    bounded_dijkstra(from, budget, settled, route_scratch);
+
+    std::vector<std::pair<Coord, Distance>> result;
+    result.reserve(settled.size());
+    for (int crossroad : settled) {
+        result.push_back({crossroads_vector[crossroad].position, route_scratch.dist[0][crossroad]});
+    }
+    return result;
+}
+
+std::vector<PlaceID> Datastructures::places_reachable_within(Coord fromxy, Distance budget)
+{
+    int from = crossroad_id(fromxy);
+    if (from < 0 || budget < 0) {
+        return {};
+    }
+    if (place_snaps_epoch != graph_epoch) {
+        attach_places();
+    }
+    std::vector<int> settled;
+    bounded_dijkstra(from, budget, settled, route_scratch);
+
+    //a place is reached once the rest of the way from a settled end fits in the budget.
+    //Places in the middle of a way are listed at both ends and may be found twice.
+    std::vector<PlaceID> result;
+    for (int crossroad : settled) {
+        Distance left = budget - route_scratch.dist[0][crossroad];
+        for (auto const& [place, extra] : crossroad_places[crossroad]) {
+            if (extra <= left) {
+                result.push_back(place);
+            }
+        }
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+Distance Datastructures::trim_ways()
+{
+    //both algorithms give the same minimum spanning forest, ways outside it get removed
+    std::vector<bool> keep = trim_algorithm == TrimAlgorithm::BORUVKA ? boruvka_forest() : kruskal_forest();
+    Distance remaining = 0;
+    trimmed_way_ids.clear();
+    trimmed_total = 0;
+    for (std::size_t i = 0; i < ways_vector.size(); ++i) {
+        if (keep[i]) {
+            remaining += ways_vector[i].waylength;
+        }
+        else {
+            trimmed_way_ids.push_back(ways_vector[i].id);
+            trimmed_total += ways_vector[i].waylength;
+            way_coord_holes += ways_vector[i].coords_count;
+        }
+    }
+
+    if (!trimmed_way_ids.empty()) {
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < ways_vector.size(); ++i) {
+            if (keep[i]) {
+                if (kept != i) {
+                    ways_vector[kept] = std::move(ways_vector[i]);
+                }
+                ++kept;
+            }
+        }
+        ways_vector.resize(kept);
+        compact_way_coords();
+        rebuild_way_graph();
+    }
+    return remaining;
+}
+
+std::vector<WayID> Datastructures::trimmed_ways()
+{
+    return trimmed_way_ids;
+}
+
+Distance Datastructures::trimmed_length()
+{
+    return trimmed_total;
+}
+
+void Datastructures::set_trim_algorithm(TrimAlgorithm algorithm)
+{
+    trim_algorithm = algorithm;
+}
+
+void Datastructures::set_worker_threads(unsigned int threads)
+{
+    worker_threads = threads;
+}
+
+void Datastructures::set_route_cache_size(std::size_t entries)
+{
+    route_cache_limit = entries;
+    while (route_cache_lru.size() > route_cache_limit) {
+        route_cache_map.erase(route_cache_lru.back().key);
+        route_cache_lru.pop_back();
+    }
+}
+
+RouteCacheStats Datastructures::route_cache_stats()
+{
+    RouteCacheStats stats;
+    stats.hits = route_cache_hits;
+    stats.misses = route_cache_misses;
+    stats.entries = route_cache_lru.size();
+    stats.limit = route_cache_limit;
+    return stats;
+}
+
+//Returns the cached result of the query, or nullptr if there is none for the current
+//graph. A hit moves the entry to the front of the LRU list.
+std::vector<std::tuple<Coord, WayID, Distance>> const* Datastructures::cached_route(Route_cache_key const& key)
+{
+    if (route_cache_limit == 0) {
+        return nullptr;
+    }
+    auto iter = route_cache_map.find(key);
+    if (iter == route_cache_map.end()) {
+        ++route_cache_misses;
+        return nullptr;
+    }
+    if (iter->second->epoch != graph_epoch) {
+        route_cache_lru.erase(iter->second);
+        route_cache_map.erase(iter);
+        ++route_cache_misses;
+        return nullptr;
+    }
+    ++route_cache_hits;
+    route_cache_lru.splice(route_cache_lru.begin(), route_cache_lru, iter->second);
+    return &route_cache_lru.front().route;
+}
+
+void Datastructures::remember_route(Route_cache_key const& key, std::vector<std::tuple<Coord, WayID, Distance>> const& route)
+{
+    if (route_cache_limit == 0) {
+        return;
+    }
+    //reuse the least recently used entry when the cache is full
+    if (route_cache_lru.size() >= route_cache_limit) {
+        route_cache_map.erase(route_cache_lru.back().key);
+        route_cache_lru.splice(route_cache_lru.begin(), route_cache_lru, std::prev(route_cache_lru.end()));
+        Route_cache_entry& entry = route_cache_lru.front();
+        entry.key = key;
+        entry.epoch = graph_epoch;
+        entry.route = route;
+    }
+    else {
+        route_cache_lru.push_front({key, graph_epoch, route});
+    }
+    route_cache_map[key] = route_cache_lru.begin();
+    route_cache_epoch = graph_epoch;
+}
+
+//Carries the cached routes of the previous epoch over when the new way can't change them.
+//A route whose end is an end of the new way may have changed from "not a crossroad".
+//Otherwise a route stays when one of its ends still isn't a crossroad, when the way is a
+//loop, when the way isn't in the component of its start, when its ends are still
+//disconnected, or for shortest routes when the landmark bounds show that going through
+//the way can't be shorter.
+void Datastructures::route_cache_way_added(int way_index)
+{
+    if (route_cache_epoch + 1 != graph_epoch) {
+        return;
+    }
+    Way const& way = ways_vector[way_index];
+    Coord ends[2] = {crossroads_vector[way.start_ver].position, crossroads_vector[way.end_ver].position};
+    bool bounds = !landmarks.empty() && !landmarks_stale;
+    for (Route_cache_entry& entry : route_cache_lru) {
+        if (entry.epoch + 1 != graph_epoch) {
+            continue;
+        }
+        Route_cache_key const& key = entry.key;
+        if (key.from == ends[0] || key.from == ends[1] || key.to == ends[0] || key.to == ends[1]) {
+            continue;
+        }
+        int from = crossroad_id(key.from);
+        int to = crossroad_id(key.to);
+        bool still_right = false;
+        if (from < 0 || to < 0 || way.start_ver == way.end_ver) {
+            still_right = true;
+        }
+        else if (!components_stale && crossroad_components.find(from) != crossroad_components.find(way.start_ver)) {
+            still_right = true;
+        }
+        else if (entry.route.empty()) {
+            still_right = !components_stale && crossroad_components.find(from) != crossroad_components.find(to);
+        }
+        else if (key.kind == RouteKind::SHORTEST_DISTANCE && bounds) {
+            std::uint64_t length = std::get<2>(entry.route.back());
+            auto through = [&](int first, int second) {
+                return static_cast<std::uint64_t>(landmark_bound(from, first)) + way.waylength + landmark_bound(second, to);
+            };
+            still_right = through(way.start_ver, way.end_ver) >= length && through(way.end_ver, way.start_ver) >= length;
+        }
+        if (still_right) {
+            entry.epoch = graph_epoch;
+            route_cache_epoch = graph_epoch;
+        }
+    }
+}
+
+//After a removal the other distances can only have grown, so every cached route that
+//didn't use the way or start or end at it is still right.
+void Datastructures::route_cache_way_removed(WayID const& id, Coord from, Coord to)
+{
+    if (route_cache_epoch + 1 != graph_epoch) {
+        return;
+    }
+    for (Route_cache_entry& entry : route_cache_lru) {
+        if (entry.epoch + 1 != graph_epoch) {
+            continue;
+        }
+        Route_cache_key const& key = entry.key;
+        if (key.from == from || key.from == to || key.to == from || key.to == to) {
+            continue;
+        }
+        bool used = std::any_of(entry.route.begin(), entry.route.end(),
+                                [&id](std::tuple<Coord, WayID, Distance> const& step) { return std::get<1>(step) == id; });
+        if (!used) {
+            entry.epoch = graph_epoch;
+            route_cache_epoch = graph_epoch;
+        }
+    }
+}
+
+void Datastructures::set_route_search(RouteSearch mode)
+{
+    route_search = mode;
+}
+
+RouteSearch Datastructures::get_route_search()
+{
+    return route_search;
+}
+
+void Datastructures::set_chain_compression(bool enabled)
+{
+    chain_compression = enabled;
+}
+
+void Datastructures::set_hilbert_order(bool enabled)
+{
+    hilbert_order = enabled;
+}
+
+int Datastructures::prepare_routing()
+{
+    int crossroads = crossroads_vector.size();
+    ch_ready = false;
+    ch_edges.clear();
+
+    //every way is an edge to start with, loops can never be part of a shortest route
+    std::vector<std::vector<int>> adjacency(crossroads);
+    for (unsigned long i = 0; i < ways_vector.size(); ++i) {
+        Way const& way = ways_vector[i];
+        if (way.start_ver == way.end_ver) {
+            continue;
+        }
+        int edge = ch_edges.size();
+        ch_edges.push_back({{way.start_ver, way.end_ver}, way.waylength, static_cast<int>(i), {-1, -1}});
+        adjacency[way.start_ver].push_back(edge);
+        adjacency[way.end_ver].push_back(edge);
+    }
+    int original_edges = ch_edges.size();
+
+    std::vector<int> rank(crossroads, -1);
+    std::vector<int> contracted_neighbours(crossroads, 0);
+    Route_scratch witness;
+
+    //contract the cheapest crossroad first: few shortcuts compared to the edges it removes,
+    //and not too many already contracted neighbours so the hierarchy stays even
+    auto priority = [&](int crossroad) {
+        int degree = 0;
+        for (int edge : adjacency[crossroad]) {
+            Ch_edge const& e = ch_edges[edge];
+            if (rank[e.ends[0] == crossroad ? e.ends[1] : e.ends[0]] < 0) {
+                ++degree;
+            }
+        }
+        return contract_crossroad(crossroad, true, adjacency, rank, witness) - degree
+                + contracted_neighbours[crossroad];
+    };
+
+    using Order_entry = std::pair<int, int>;
+    std::priority_queue<Order_entry, std::vector<Order_entry>, std::greater<Order_entry>> order;
+    for (int i = 0; i < crossroads; ++i) {
+        order.push({priority(i), i});
+    }
+
+    int next_rank = 0;
+    while (!order.empty()) {
+        int crossroad = order.top().second;
+        order.pop();
+        if (rank[crossroad] >= 0) {
+            continue;
+        }
+        //priorities go stale as neighbours get contracted, recheck before committing
+        int current = priority(crossroad);
+        if (!order.empty() && current > order.top().first) {
+            order.push({current, crossroad});
+            continue;
+        }
+        contract_crossroad(crossroad, false, adjacency, rank, witness);
+        rank[crossroad] = next_rank++;
+        //the neighbours don't need their edges to this crossroad anymore
+        for (int edge : adjacency[crossroad]) {
+            Ch_edge const& e = ch_edges[edge];
+            int next = e.ends[0] == crossroad ? e.ends[1] : e.ends[0];
+            if (rank[next] >= 0) {
+                continue;
+            }
+            ++contracted_neighbours[next];
+            std::vector<int>& next_edges = adjacency[next];
+            next_edges.erase(std::remove(next_edges.begin(), next_edges.end(), edge), next_edges.end());
+        }
+        adjacency[crossroad].clear();
+        adjacency[crossroad].shrink_to_fit();
+    }
+
+    //query graph: each edge is stored once, at its lower ranked end
+    ch_up_begin.assign(crossroads + 1, 0);
+    for (Ch_edge const& e : ch_edges) {
+        int lower = rank[e.ends[0]] < rank[e.ends[1]] ? e.ends[0] : e.ends[1];
+        ++ch_up_begin[lower + 1];
+    }
+    for (int i = 0; i < crossroads; ++i) {
+        ch_up_begin[i + 1] += ch_up_begin[i];
+    }
+    ch_up_arcs.resize(ch_edges.size());
+    std::vector<int> fill = ch_up_begin;
+    for (unsigned long i = 0; i < ch_edges.size(); ++i) {
+        Ch_edge const& e = ch_edges[i];
+        int lower = rank[e.ends[0]] < rank[e.ends[1]] ? 0 : 1;
+        ch_up_arcs[fill[e.ends[lower]]++] = {e.ends[1-lower], e.length, static_cast<int>(i)};
+    }
+
+    ch_ready = true;
+    return ch_edges.size() - original_edges;
+}
+
+bool Datastructures::are_connected(Coord fromxy, Coord toxy)
+{
+    int from = crossroad_id(fromxy);
+    int to = crossroad_id(toxy);
+    if (from < 0 || to < 0) {
+        return false;
+    }
+    refresh_components();
+    return crossroad_components.find(from) == crossroad_components.find(to);
+}
+
+int Datastructures::component_size(Coord xy)
+{
+    int crossroad = crossroad_id(xy);
+    if (crossroad < 0) {
+        return 0;
+    }
+    refresh_components();
+    return crossroad_components.set_size(crossroad);
+}
+
+//True only when both ends are crossroads in different components, the route queries
+//answer those without a search.
+bool Datastructures::disconnected(Coord fromxy, Coord toxy)
+{
+    int from = crossroad_id(fromxy);
+    int to = crossroad_id(toxy);
+    if (from < 0 || to < 0) {
+        return false;
+    }
+    refresh_components();
+    return crossroad_components.find(from) != crossroad_components.find(to);
+}
+
+void Datastructures::refresh_components()
+{
+    if (!components_stale) {
+        return;
+    }
+    crossroad_components.reset(crossroads_vector.size());
+    for (Way const& way : ways_vector) {
+        crossroad_components.unite(way.start_ver, way.end_ver);
+    }
+    components_stale = false;
+}
+
+void Datastructures::routing_changed()
+{
+    //cached routes go stale lazily through the epoch
+    ++graph_epoch;
+    chains_stale = true;
+    segments_stale = true;
+    //the hierarchy describes the old graph, drop it and fall back to plain searches
+    ch_ready = false;
+    ch_edges.clear();
+    ch_up_begin.clear();
+    ch_up_arcs.clear();
+}
+
+//Removes "crossroad" from the remaining graph and adds a shortcut between each pair of
+//its neighbours whose shortest connection went through it. With simulate only counts
+//the shortcuts that would be needed.
+int Datastructures::contract_crossroad(int crossroad, bool simulate, std::vector<std::vector<int>>& adjacency,
+                                       std::vector<int> const& rank, Route_scratch& witness)
+{
+    //shortest edge to each uncontracted neighbour
+    std::vector<std::pair<int, int>> neighbours;
+    for (int edge : adjacency[crossroad]) {
+        Ch_edge const& e = ch_edges[edge];
+        int next = e.ends[0] == crossroad ? e.ends[1] : e.ends[0];
+        if (rank[next] < 0) {
+            neighbours.push_back({next, edge});
+        }
+    }
+    std::sort(neighbours.begin(), neighbours.end(), [this](auto const& a, auto const& b) {
+        return a.first < b.first || (a.first == b.first && ch_edges[a.second].length < ch_edges[b.second].length);
+    });
+    neighbours.erase(std::unique(neighbours.begin(), neighbours.end(),
+                                 [](auto const& a, auto const& b) { return a.first == b.first; }),
+                     neighbours.end());
+
+    int shortcuts = 0;
+    auto heap_comp = std::greater<std::pair<Distance, int>>();
+    for (unsigned long i = 0; i + 1 < neighbours.size(); ++i) {
+        auto [source, first_edge] = neighbours[i];
+        Distance first_length = ch_edges[first_edge].length;
+        Distance limit = 0;
+        for (unsigned long j = i + 1; j < neighbours.size(); ++j) {
+            limit = std::max(limit, first_length + ch_edges[neighbours[j].second].length);
+        }
+
+        //bounded Dijkstra from source that is not allowed to pass through crossroad
+        witness.next_query(adjacency.size());
+        unsigned int stamp = witness.stamp;
+        std::vector<std::pair<Distance, int>>& heap = witness.heap[0];
+        std::vector<Distance>& dist = witness.dist[0];
+        heap.clear();
+        witness.seen[0][source] = stamp;
+        dist[source] = 0;
+        heap.push_back({0, source});
+        int settled = 0;
+        while (!heap.empty() && settled < WITNESS_SETTLE_LIMIT) {
+            std::pop_heap(heap.begin(), heap.end(), heap_comp);
+            auto [current_dist, current] = heap.back();
+            heap.pop_back();
+            if (current_dist > dist[current]) {
+                continue;
+            }
+            if (current_dist > limit) {
+                break;
+            }
+            ++settled;
+            for (int edge : adjacency[current]) {
+                Ch_edge const& e = ch_edges[edge];
+                int next = e.ends[0] == current ? e.ends[1] : e.ends[0];
+                if (next == crossroad || rank[next] >= 0) {
+                    continue;
+                }
+                Distance next_dist = current_dist + e.length;
+                if (witness.seen[0][next] != stamp || next_dist < dist[next]) {
+                    witness.seen[0][next] = stamp;
+                    dist[next] = next_dist;
+                    heap.push_back({next_dist, next});
+                    std::push_heap(heap.begin(), heap.end(), heap_comp);
+                }
+            }
+        }
+
+        for (unsigned long j = i + 1; j < neighbours.size(); ++j) {
+            auto [target, second_edge] = neighbours[j];
+            Distance via = first_length + ch_edges[second_edge].length;
+            if (witness.seen[0][target] == stamp && dist[target] <= via) {
+                continue;
+            }
+            ++shortcuts;
+            if (!simulate) {
+                int edge = ch_edges.size();
+                ch_edges.push_back({{source, target}, via, -1, {first_edge, second_edge}});
+                adjacency[source].push_back(edge);
+                adjacency[target].push_back(edge);
+            }
+        }
+    }
+    return shortcuts;
+}
+
+//Bidirectional Dijkstra that only moves upwards in the hierarchy. A side stops once
+//its heap top can't beat the best route found. Parent entries are hierarchy edges.
+int Datastructures::ch_route(int from, int to, Route_scratch& scratch) const
+{
+    unsigned int stamp = scratch.stamp;
+    auto heap_comp = std::greater<std::pair<Distance, int>>();
+    int ends[2] = {from, to};
+    for (int side = 0; side < 2; ++side) {
+        scratch.heap[side].clear();
+        scratch.heap[side].push_back({0, ends[side]});
+        scratch.seen[side][ends[side]] = stamp;
+        scratch.parent_way[side][ends[side]] = -1;
+        scratch.dist[side][ends[side]] = 0;
+    }
+    if (from == to) {
+        return from;
+    }
+
+    Distance best = std::numeric_limits<Distance>::max();
+    int meet = -1;
+    bool active[2] = {true, true};
+    int side = 0;
+    while (active[0] || active[1]) {
+        if (!active[side]) {
+            side = 1 - side;
+        }
+        std::vector<std::pair<Distance, int>>& heap = scratch.heap[side];
+        std::vector<Distance>& dist = scratch.dist[side];
+        if (heap.empty() || heap.front().first >= best) {
+            active[side] = false;
+            continue;
+        }
+        std::pop_heap(heap.begin(), heap.end(), heap_comp);
+        auto [current_dist, current] = heap.back();
+        heap.pop_back();
+
+        if (current_dist <= dist[current]) {
+            if (scratch.seen[1-side][current] == stamp && current_dist + scratch.dist[1-side][current] < best) {
+                best = current_dist + scratch.dist[1-side][current];
+                meet = current;
+            }
+            for (int i = ch_up_begin[current]; i < ch_up_begin[current + 1]; ++i) {
+                Ch_arc const& arc = ch_up_arcs[i];
+                Distance next_dist = current_dist + arc.length;
+                if (scratch.seen[side][arc.target] != stamp || next_dist < dist[arc.target]) {
+                    scratch.seen[side][arc.target] = stamp;
+                    scratch.parent_way[side][arc.target] = arc.edge;
+                    dist[arc.target] = next_dist;
+                    heap.push_back({next_dist, arc.target});
+                    std::push_heap(heap.begin(), heap.end(), heap_comp);
+                }
+            }
+        }
+        side = 1 - side;
+    }
+    return meet;
+}
+
+//Appends the ways behind a hierarchy edge to scratch.way_path, in the order they are
+//travelled when starting from "from".
+void Datastructures::unpack_ch_edge(int edge, int from, Route_scratch& scratch) const
+{
+    std::vector<std::pair<int, int>>& stack = scratch.unpack_stack;
+    stack.clear();
+    stack.push_back({edge, from});
+    while (!stack.empty()) {
+        auto [current, start] = stack.back();
+        stack.pop_back();
+        Ch_edge const& e = ch_edges[current];
+        if (e.way_index >= 0) {
+            scratch.way_path.push_back(e.way_index);
+            continue;
+        }
+        int first = e.ends[0] == start ? 0 : 1;
+        Ch_edge const& first_child = ch_edges[e.children[first]];
+        int middle = first_child.ends[0] == start ? first_child.ends[1] : first_child.ends[0];
+        stack.push_back({e.children[1-first], middle});
+        stack.push_back({e.children[first], start});
+    }
+}
+
+int Datastructures::prepare_landmarks(int count)
+{
+    int crossroads = crossroads_vector.size();
+    landmarks.clear();
+    landmark_dist.clear();
+    landmarks_stale = false;
+    if (crossroads == 0 || count <= 0) {
+        return 0;
+    }
+
+    //farthest point selection: start from the crossroad farthest from crossroad 0, then
+    //always take the one farthest from all landmarks so far. Unreachable crossroads count
+    //as the farthest, so every component gets a landmark before any gets a second one.
+    std::vector<std::pair<Distance, int>> heap;
+    std::vector<std::uint32_t> row;
+    landmark_dijkstra(0, row, heap);
+    int next = 0;
+    for (int i = 0; i < crossroads; ++i) {
+        if (row[i] != LANDMARK_UNREACHABLE && row[i] > row[next]) {
+            next = i;
+        }
+    }
+
+    std::vector<std::uint32_t> closest(crossroads, LANDMARK_UNREACHABLE);
+    while (static_cast<int>(landmarks.size()) < count) {
+        landmarks.push_back(next);
+        landmark_dist.emplace_back();
+        landmark_dijkstra(next, landmark_dist.back(), heap);
+
+        std::vector<std::uint32_t> const& added = landmark_dist.back();
+        next = -1;
+        for (int i = 0; i < crossroads; ++i) {
+            closest[i] = std::min(closest[i], added[i]);
+            if (closest[i] > 0 && (next < 0 || closest[i] > closest[next])) {
+                next = i;
+            }
+        }
+        //every crossroad is a landmark already
+        if (next < 0) {
+            break;
+        }
+    }
+    return landmarks.size();
+}
+
+//Full Dijkstra from the landmark, row gets the distance to every crossroad.
+void Datastructures::landmark_dijkstra(int landmark, std::vector<std::uint32_t>& row,
+                                       std::vector<std::pair<Distance, int>>& heap) const
+{
+    auto heap_comp = std::greater<std::pair<Distance, int>>();
+    row.assign(crossroads_vector.size(), LANDMARK_UNREACHABLE);
+    heap.clear();
+    row[landmark] = 0;
+    heap.push_back({0, landmark});
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), heap_comp);
+        auto [current_dist, current] = heap.back();
+        heap.pop_back();
+        if (static_cast<std::uint32_t>(current_dist) > row[current]) {
+            continue;
+        }
+        for (int way_index : crossroads_vector[current].way_indexes) {
+            int next = other_end(way_index, current);
+            std::uint32_t next_dist = current_dist + ways_vector[way_index].waylength;
+            if (next_dist < row[next]) {
+                row[next] = next_dist;
+                heap.push_back({static_cast<Distance>(next_dist), next});
+                std::push_heap(heap.begin(), heap.end(), heap_comp);
+            }
+        }
+    }
+}
+
+//Recomputes the tables of the current landmarks, each landmark is independent so
+//they are split between the worker threads.
+void Datastructures::rebuild_landmark_tables()
+{
+    unsigned int threads = std::min<unsigned int>(thread_count(), landmarks.size());
+    landmark_dist.resize(landmarks.size());
+
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < threads; ++t) {
+        workers.emplace_back([this, t, threads]() {
+            std::vector<std::pair<Distance, int>> heap;
+            for (unsigned int i = t; i < landmarks.size(); i += threads) {
+                landmark_dijkstra(landmarks[i], landmark_dist[i], heap);
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    landmarks_stale = false;
+}
+
+//A new way can only make distances shorter, so the tables are fixed by a Dijkstra that
+//starts from the ends of the way and only continues where a distance went down.
+void Datastructures::landmarks_way_added(int way_index)
+{
+    if (landmarks.empty() || landmarks_stale) {
+        return;
+    }
+    auto heap_comp = std::greater<std::pair<Distance, int>>();
+    std::vector<std::pair<Distance, int>>& heap = route_scratch.heap[0];
+    Way const& way = ways_vector[way_index];
+    std::uint32_t length = way.waylength;
+
+    for (std::vector<std::uint32_t>& row : landmark_dist) {
+        row.resize(crossroads_vector.size(), LANDMARK_UNREACHABLE);
+        heap.clear();
+        int ends[2] = {way.start_ver, way.end_ver};
+        for (int side = 0; side < 2; ++side) {
+            std::uint32_t from_dist = row[ends[side]];
+            if (from_dist != LANDMARK_UNREACHABLE && from_dist + length < row[ends[1-side]]) {
+                row[ends[1-side]] = from_dist + length;
+                heap.push_back({static_cast<Distance>(row[ends[1-side]]), ends[1-side]});
+            }
+        }
+        std::make_heap(heap.begin(), heap.end(), heap_comp);
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), heap_comp);
+            auto [current_dist, current] = heap.back();
+            heap.pop_back();
+            if (static_cast<std::uint32_t>(current_dist) > row[current]) {
+                continue;
+            }
+            for (int next_way : crossroads_vector[current].way_indexes) {
+                int next = other_end(next_way, current);
+                std::uint32_t next_dist = current_dist + ways_vector[next_way].waylength;
+                if (next_dist < row[next]) {
+                    row[next] = next_dist;
+                    heap.push_back({static_cast<Distance>(next_dist), next});
+                    std::push_heap(heap.begin(), heap.end(), heap_comp);
+                }
+            }
+        }
+    }
+}
+
+//Repairs the landmark tables after the way between crossroads "from" and "to" was
+//removed, in the style of Ramalingam and Reps. First the crossroads whose every shortest
+//path used the way are found in order of their old distance, then a Dijkstra limited to
+//them gives their new distances. The rest of each table stays as it is.
+void Datastructures::landmarks_way_removed(int from, int to, Distance length)
+{
+    if (landmarks.empty() || landmarks_stale || from == to) {
+        return;
+    }
+    auto heap_comp = std::greater<std::pair<Distance, int>>();
+    std::vector<std::pair<Distance, int>>& heap = route_scratch.heap[0];
+    std::vector<int> affected;
+
+    for (std::vector<std::uint32_t>& row : landmark_dist) {
+        //only a way on a shortest path matters, and then only for the far end of it
+        int child = -1;
+        if (row[from] != LANDMARK_UNREACHABLE && row[from] + length == row[to]) {
+            child = to;
+        }
+        else if (row[to] != LANDMARK_UNREACHABLE && row[to] + length == row[from]) {
+            child = from;
+        }
+        if (child < 0) {
+            continue;
+        }
+
+        //seen[0] marks the crossroads already looked at, seen[1] the affected ones
+        route_scratch.next_query(crossroads_vector.size());
+        unsigned int stamp = route_scratch.stamp;
+        std::vector<unsigned int>& checked = route_scratch.seen[0];
+        std::vector<unsigned int>& lost = route_scratch.seen[1];
+        affected.clear();
+        heap.clear();
+        heap.push_back({static_cast<Distance>(row[child]), child});
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), heap_comp);
+            int current = heap.back().second;
+            heap.pop_back();
+            if (checked[current] == stamp) {
+                continue;
+            }
+            checked[current] = stamp;
+            //a neighbour closer by the length of the way between them still carries the
+            //distance. Ways between different crossroads are at least 1 long, so every such
+            //neighbour is closer and has been decided already. A loop carries nothing.
+            bool supported = false;
+            for (int way_index : crossroads_vector[current].way_indexes) {
+                int next = other_end(way_index, current);
+                if (next != current && row[next] != LANDMARK_UNREACHABLE
+                    && row[next] + ways_vector[way_index].waylength == row[current] && lost[next] != stamp) {
+                    supported = true;
+                    break;
+                }
+            }
+            if (supported) {
+                continue;
+            }
+            lost[current] = stamp;
+            affected.push_back(current);
+            for (int way_index : crossroads_vector[current].way_indexes) {
+                int next = other_end(way_index, current);
+                if (checked[next] != stamp && row[next] == row[current] + ways_vector[way_index].waylength) {
+                    heap.push_back({static_cast<Distance>(row[next]), next});
+                    std::push_heap(heap.begin(), heap.end(), heap_comp);
+                }
+            }
+        }
+
+        //start each affected crossroad from its best unaffected neighbour
+        heap.clear();
+        for (int crossroad : affected) {
+            row[crossroad] = LANDMARK_UNREACHABLE;
+            for (int way_index : crossroads_vector[crossroad].way_indexes) {
+                int next = other_end(way_index, crossroad);
+                if (lost[next] != stamp && row[next] != LANDMARK_UNREACHABLE) {
+                    row[crossroad] = std::min(row[crossroad], row[next] + ways_vector[way_index].waylength);
+                }
+            }
+            if (row[crossroad] != LANDMARK_UNREACHABLE) {
+                heap.push_back({static_cast<Distance>(row[crossroad]), crossroad});
+            }
+        }
+        std::make_heap(heap.begin(), heap.end(), heap_comp);
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), heap_comp);
+            auto [current_dist, current] = heap.back();
+            heap.pop_back();
+            if (static_cast<std::uint32_t>(current_dist) > row[current]) {
+                continue;
+            }
+            for (int way_index : crossroads_vector[current].way_indexes) {
+                int next = other_end(way_index, current);
+                std::uint32_t next_dist = current_dist + ways_vector[way_index].waylength;
+                if (lost[next] == stamp && next_dist < row[next]) {
+                    row[next] = next_dist;
+                    heap.push_back({static_cast<Distance>(next_dist), next});
+                    std::push_heap(heap.begin(), heap.end(), heap_comp);
+                }
+            }
+        }
+    }
+}
+
+//Lower bound of the distance between two crossroads from the landmark tables,
+//LANDMARK_UNREACHABLE when a landmark shows that there is no route.
+std::uint32_t Datastructures::landmark_bound(int from, int to) const
+{
+    std::uint32_t bound = 0;
+    for (std::vector<std::uint32_t> const& row : landmark_dist) {
+        if (row[from] == LANDMARK_UNREACHABLE || row[to] == LANDMARK_UNREACHABLE) {
+            if (row[from] != row[to]) {
+                return LANDMARK_UNREACHABLE;
+            }
+            continue;
+        }
+        bound = std::max(bound, row[from] > row[to] ? row[from] - row[to] : row[to] - row[from]);
+    }
+    return bound;
+}
+
+//A* with the landmark lower bounds |d(L,to) - d(L,v)| as the heuristic. The bound is
+//consistent, so "to" has its final distance when it is popped. dist[1] holds the heap
+//keys so that stale heap entries can be recognised.
+int Datastructures::astar_route(int from, int to, Route_scratch& scratch) const
+{
+    //pick the landmarks that separate the route ends best
+    std::pair<std::uint32_t, int> best_landmarks[ACTIVE_LANDMARKS];
+    unsigned int active = 0;
+    for (unsigned int i = 0; i < landmarks.size(); ++i) {
+        std::uint32_t at_from = landmark_dist[i][from];
+        std::uint32_t at_to = landmark_dist[i][to];
+        if (at_from == LANDMARK_UNREACHABLE || at_to == LANDMARK_UNREACHABLE) {
+            //the landmark reaches only one of the ends, so there is no route at all
+            if (at_from != at_to) {
+                return -1;
+            }
+            continue;
+        }
+        std::uint32_t bound = at_from > at_to ? at_from - at_to : at_to - at_from;
+        std::pair<std::uint32_t, int> candidate = {bound, static_cast<int>(i)};
+        if (active < ACTIVE_LANDMARKS) {
+            best_landmarks[active++] = candidate;
+        }
+        else {
+            auto weakest = std::min_element(best_landmarks, best_landmarks + active);
+            if (*weakest < candidate) {
+                *weakest = candidate;
+            }
+        }
+    }
+
+    auto heuristic = [&](int crossroad) {
+        std::uint32_t bound = 0;
+        for (unsigned int i = 0; i < active; ++i) {
+            std::vector<std::uint32_t> const& row = landmark_dist[best_landmarks[i].second];
+            std::uint32_t at_node = row[crossroad];
+            std::uint32_t at_to = row[to];
+            //the active landmarks reach "to", so a crossroad they don't reach can't either
+            if (at_node == LANDMARK_UNREACHABLE) {
+                return LANDMARK_UNREACHABLE;
+            }
+            bound = std::max(bound, at_node > at_to ? at_node - at_to : at_to - at_node);
+        }
+        return bound;
+    };
+
+    unsigned int stamp = scratch.stamp;
+    std::vector<std::pair<Distance, int>>& heap = scratch.heap[0];
+    std::vector<Distance>& dist = scratch.dist[0];
+    std::vector<Distance>& key = scratch.dist[1];
+    auto heap_comp = std::greater<std::pair<Distance, int>>();
+
+    heap.clear();
+    scratch.seen[0][from] = stamp;
+    scratch.parent_way[0][from] = -1;
+    dist[from] = 0;
+    key[from] = heuristic(from);
+    heap.push_back({key[from], from});
+
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), heap_comp);
+        auto [current_key, current] = heap.back();
+        heap.pop_back();
+        if (current_key > key[current]) {
+            continue;
+        }
+        if (current == to) {
+            return to;
+        }
+        for (int way_index : crossroads_vector[current].way_indexes) {
+            int next = other_end(way_index, current);
+            Distance next_dist = dist[current] + ways_vector[way_index].waylength;
+            if (scratch.seen[0][next] != stamp || next_dist < dist[next]) {
+                std::uint32_t bound = heuristic(next);
+                if (bound == LANDMARK_UNREACHABLE) {
+                    continue;
+                }
+                scratch.seen[0][next] = stamp;
+                scratch.parent_way[0][next] = way_index;
+                dist[next] = next_dist;
+                key[next] = next_dist + static_cast<Distance>(bound);
+                heap.push_back({key[next], next});
+                std::push_heap(heap.begin(), heap.end(), heap_comp);
+            }
+        }
+    }
+    return -1;
+}
+
+
+void Datastructures::Crossroad_queue::reset(std::size_t capacity)
+{
+    if (items.size() < capacity) {
+        items.resize(capacity);
+    }
+    head = 0;
+    count = 0;
+}
+
+void Datastructures::Crossroad_queue::push(int crossroad)
+{
+    std::size_t tail = head + count;
+    if (tail >= items.size()) {
+        tail -= items.size();
+    }
+    items[tail] = crossroad;
+    ++count;
+}
+
+int Datastructures::Crossroad_queue::pop()
+{
+    int crossroad = items[head];
+    ++head;
+    if (head == items.size()) {
+        head = 0;
+    }
+    --count;
+    return crossroad;
+}
+
+//Builds the junction graph. Crossroads with exactly two ways, neither of them a loop, are
+//inside a chain, all other crossroads are junctions. Each chain between two junctions
+//becomes one edge. A ring with no junctions on it gets one of its crossroads as one.
+void Datastructures::rebuild_chains()
+{
+    std::size_t crossroads = crossroads_vector.size();
+    chains.clear();
+    chain_ways.clear();
+    chain_of.assign(crossroads, -1);
+    chain_pos.assign(crossroads, 0);
+    chain_offset.assign(crossroads, 0);
+    junction_chains.assign(crossroads, {});
+    std::vector<bool> way_done(ways_vector.size(), false);
+
+    auto inside_chain = [this](int crossroad) {
+        std::vector<int> const& ways = crossroads_vector[crossroad].way_indexes;
+        return ways.size() == 2
+               && ways_vector[ways[0]].start_ver != ways_vector[ways[0]].end_ver
+               && ways_vector[ways[1]].start_ver != ways_vector[ways[1]].end_ver;
+    };
+    //follows the chain from "start" along "first_way" until the next junction
+    auto walk = [&](int start, int first_way) {
+        int index = chains.size();
+        Chain chain = {{start, start}, 0, static_cast<int>(chain_ways.size()), 0};
+        int node = start;
+        int way = first_way;
+        while (true) {
+            way_done[way] = true;
+            chain_ways.push_back(way);
+            chain.length += ways_vector[way].waylength;
+            ++chain.count;
+            node = other_end(way, node);
+            if (node == start || !inside_chain(node)) {
+                break;
+            }
+            chain_of[node] = index;
+            chain_pos[node] = chain.count;
+            chain_offset[node] = chain.length;
+            std::vector<int> const& ways = crossroads_vector[node].way_indexes;
+            way = ways[0] == way ? ways[1] : ways[0];
+        }
+        chain.ends[1] = node;
+        chains.push_back(chain);
+        junction_chains[start].push_back(index);
+        if (node != start) {
+            junction_chains[node].push_back(index);
+        }
+    };
+
+    for (std::size_t crossroad = 0; crossroad < crossroads; ++crossroad) {
+        if (!inside_chain(crossroad)) {
+            for (int way : crossroads_vector[crossroad].way_indexes) {
+                if (!way_done[way]) {
+                    walk(crossroad, way);
+                }
+            }
+        }
+    }
+    for (std::size_t crossroad = 0; crossroad < crossroads; ++crossroad) {
+        if (inside_chain(crossroad) && chain_of[crossroad] < 0 && !way_done[crossroads_vector[crossroad].way_indexes[0]]) {
+            walk(crossroad, crossroads_vector[crossroad].way_indexes[0]);
+        }
+    }
+    chains_stale = false;
+}
+
+//Dijkstra on the junction graph. A start or end inside a chain is joined to the
+//junctions at both ends of its chain by the part of the chain between them. parent_way[0]
+//of a junction is 2*chain+direction of the chain it was reached by, direction 0 meaning
+//from ends[0] to ends[1]. The start itself has -1, and the ends of the start's own chain
+//have -2-direction. Fills way_path with the route, returns false if there is none.
+bool Datastructures::chain_route(int from, int to, Route_scratch& scratch) const
+{
+    unsigned int stamp = scratch.stamp;
+    std::vector<std::pair<Distance, int>>& heap = scratch.heap[0];
+    std::vector<Distance>& dist = scratch.dist[0];
+    std::vector<int>& parent = scratch.parent_way[0];
+    auto heap_comp = std::greater<std::pair<Distance, int>>();
+    heap.clear();
+
+    auto reach = [&](int node, Distance node_dist, int via) {
+        if (scratch.seen[0][node] != stamp || node_dist < dist[node]) {
+            scratch.seen[0][node] = stamp;
+            dist[node] = node_dist;
+            parent[node] = via;
+            heap.push_back({node_dist, node});
+            std::push_heap(heap.begin(), heap.end(), heap_comp);
+        }
+    };
+
+    int from_chain = chain_of[from];
+    int to_chain = chain_of[to];
+    if (from_chain < 0) {
+        reach(from, 0, -1);
+    }
+    else {
+        Chain const& chain = chains[from_chain];
+        reach(chain.ends[1], chain.length - chain_offset[from], -2);
+        reach(chain.ends[0], chain_offset[from], -3);
+    }
+
+    //how the best route so far ends: -1 at "to" itself, 0 or 1 from that end of the
+    //chain of "to", 2 straight along the chain both ends are in
+    Distance best = std::numeric_limits<Distance>::max();
+    int best_end = -1;
+    int best_side = -1;
+    if (to_chain >= 0 && to_chain == from_chain) {
+        best = std::abs(chain_offset[from] - chain_offset[to]);
+        best_side = 2;
+    }
+
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), heap_comp);
+        auto [current_dist, current] = heap.back();
+        heap.pop_back();
+        if (current_dist > dist[current]) {
+            continue;
+        }
+        if (current_dist >= best) {
+            break;
+        }
+        if (current == to) {
+            best = current_dist;
+            best_end = to;
+            best_side = -1;
+            break;
+        }
+        if (to_chain >= 0) {
+            Chain const& chain = chains[to_chain];
+            for (int side = 0; side < 2; ++side) {
+                Distance through = current_dist + (side == 0 ? chain_offset[to] : chain.length - chain_offset[to]);
+                if (chain.ends[side] == current && through < best) {
+                    best = through;
+                    best_end = current;
+                    best_side = side;
+                }
+            }
+        }
+        for (int next_chain : junction_chains[current]) {
+            Chain const& chain = chains[next_chain];
+            int direction = chain.ends[0] == current ? 0 : 1;
+            reach(chain.ends[1-direction], current_dist + chain.length, 2 * next_chain + direction);
+        }
+    }
+    if (best_side != 2 && best_end < 0) {
+        return false;
+    }
+
+    //pieces of chains from "to" back to "from" as (chain, from position, to position),
+    //positions counting ways from ends[0]
+    std::vector<int>& pieces = scratch.edge_path;
+    pieces.clear();
+    auto add_piece = [&pieces](int chain, int from_pos, int to_pos) {
+        pieces.insert(pieces.end(), {chain, from_pos, to_pos});
+    };
+    if (best_side == 2) {
+        add_piece(from_chain, chain_pos[from], chain_pos[to]);
+    }
+    else {
+        if (best_side >= 0) {
+            add_piece(to_chain, best_side == 0 ? 0 : chains[to_chain].count, chain_pos[to]);
+        }
+        for (int node = best_end; parent[node] != -1; ) {
+            int via = parent[node];
+            if (via <= -2) {
+                Chain const& chain = chains[from_chain];
+                add_piece(from_chain, chain_pos[from], via == -2 ? chain.count : 0);
+                break;
+            }
+            Chain const& chain = chains[via / 2];
+            if (via % 2 == 0) {
+                add_piece(via / 2, 0, chain.count);
+                node = chain.ends[0];
+            }
+            else {
+                add_piece(via / 2, chain.count, 0);
+                node = chain.ends[1];
+            }
+        }
+    }
+
+    std::vector<int>& way_path = scratch.way_path;
+    way_path.clear();
+    for (std::size_t i = pieces.size(); i > 0; i -= 3) {
+        int first = chains[pieces[i-3]].first;
+        int from_pos = pieces[i-2];
+        int to_pos = pieces[i-1];
+        for (int pos = from_pos; pos < to_pos; ++pos) {
+            way_path.push_back(chain_ways[first + pos]);
+        }
+        for (int pos = from_pos; pos > to_pos; --pos) {
+            way_path.push_back(chain_ways[first + pos - 1]);
+        }
+    }
+    return true;
+}
+
+void Datastructures::Union_find::reset(std::size_t size)
+{
+    parent.resize(size);
+    this->size.assign(size, 1);
+    for (std::size_t i = 0; i < size; ++i) {
+        parent[i] = i;
+    }
+}
+
+void Datastructures::Union_find::grow(std::size_t size)
+{
+    //new items start as sets of their own
+    for (std::size_t i = parent.size(); i < size; ++i) {
+        parent.push_back(i);
+        this->size.push_back(1);
+    }
+}
+
+int Datastructures::Union_find::find(int item)
+{
+    int root = item;
+    while (parent[root] != root) {
+        root = parent[root];
+    }
+    //point the whole path straight at the root
+    while (parent[item] != root) {
+        int next = parent[item];
+        parent[item] = root;
+        item = next;
+    }
+    return root;
+}
+
+bool Datastructures::Union_find::unite(int a, int b)
+{
+    a = find(a);
+    b = find(b);
+    if (a == b) {
+        return false;
+    }
+    //union by size: the smaller set goes under the larger root, whose size then counts both
+    if (size[a] < size[b]) {
+        std::swap(a, b);
+    }
+    parent[b] = a;
+    size[a] += size[b];
+    return true;
+}
+
+int Datastructures::Union_find::set_size(int item)
+{
+    return size[find(item)];
+}
+
+//Way indexes ordered by length, ties by WayID. LSD radix sort on the lengths, one byte
+//per pass and only as many passes as the longest way needs. Ties are then sorted by
+//id inside each run of equal lengths so the order doesn't depend on insertion order.
+std::vector<int> Datastructures::ways_by_length() const
+{
+    std::size_t count = ways_vector.size();
+    std::vector<int> order(count);
+    std::vector<int> buffer(count);
+    std::uint32_t longest = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        order[i] = i;
+        longest = std::max(longest, static_cast<std::uint32_t>(ways_vector[i].waylength));
+    }
+
+    for (int shift = 0; shift < 32 && (longest >> shift) > 0; shift += 8) {
+        std::size_t bucket_start[257] = {};
+        for (int way_index : order) {
+            ++bucket_start[((static_cast<std::uint32_t>(ways_vector[way_index].waylength) >> shift) & 0xff) + 1];
+        }
+        for (int b = 0; b < 256; ++b) {
+            bucket_start[b + 1] += bucket_start[b];
+        }
+        for (int way_index : order) {
+            buffer[bucket_start[(static_cast<std::uint32_t>(ways_vector[way_index].waylength) >> shift) & 0xff]++] = way_index;
+        }
+        order.swap(buffer);
+    }
+
+    for (std::size_t run = 0; run < count; ) {
+        std::size_t run_end = run + 1;
+        while (run_end < count && ways_vector[order[run_end]].waylength == ways_vector[order[run]].waylength) {
+            ++run_end;
+        }
+        if (run_end - run > 1) {
+            std::sort(order.begin() + run, order.begin() + run_end,
+                      [this](int a, int b) { return ways_vector[a].id < ways_vector[b].id; });
+        }
+        run = run_end;
+    }
+    return order;
+}
+
+//Drops a crossroad that has no ways left. The last crossroad takes its id, so the
+//ways at that one and a landmark on it are renumbered.
+void Datastructures::remove_crossroad(int crossroad)
+{
+    coord_crossroad_map.erase(crossroads_vector[crossroad].position);
+    for (std::size_t i = 0; i < landmarks.size(); ++i) {
+        if (landmarks[i] == crossroad) {
+            landmarks.erase(landmarks.begin() + i);
+            landmark_dist.erase(landmark_dist.begin() + i);
+            break;
+        }
+    }
+
+    int last = crossroads_vector.size() - 1;
+    if (crossroad != last) {
+        crossroads_vector[crossroad] = std::move(crossroads_vector[last]);
+        coord_crossroad_map[crossroads_vector[crossroad].position] = crossroad;
+        for (int way_index : crossroads_vector[crossroad].way_indexes) {
+            Way& way = ways_vector[way_index];
+            if (way.start_ver == last) {
+                way.start_ver = crossroad;
+            }
+            if (way.end_ver == last) {
+                way.end_ver = crossroad;
+            }
+        }
+        std::replace(landmarks.begin(), landmarks.end(), last, crossroad);
+    }
+    if (!landmarks_stale) {
+        for (std::vector<std::uint32_t>& row : landmark_dist) {
+            row[crossroad] = row[last];
+            row.pop_back();
+        }
+    }
+    crossroads_vector.pop_back();
+}
+
+unsigned int Datastructures::thread_count() const
+{
+    if (worker_threads > 0) {
+        return worker_threads;
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+//Strict order of the ways for the spanning forest: length first, then WayID
+bool Datastructures::shorter_way(int a, int b) const
+{
+    Way const& way_a = ways_vector[a];
+    Way const& way_b = ways_vector[b];
+    if (way_a.waylength != way_b.waylength) {
+        return way_a.waylength < way_b.waylength;
+    }
+    return way_a.id < way_b.id;
+}
+
+//Kruskal: going from the shortest way up, keep a way only if it joins two crossroads
+//that the kept ways don't connect yet.
+std::vector<bool> Datastructures::kruskal_forest() const
+{
+    Union_find components;
+    components.reset(crossroads_vector.size());
+    std::vector<bool> keep(ways_vector.size(), false);
+    for (int way_index : ways_by_length()) {
+        Way const& way = ways_vector[way_index];
+        keep[way_index] = components.unite(way.start_ver, way.end_ver);
+    }
+    return keep;
+}
+
+//Boruvka: every round each component picks its cheapest way to another component and
+//all of those are added at once, so the number of components at least halves. Picking
+//the cheapest ways and relabelling the crossroads is split between the worker threads,
+//the picks meet in one atomic slot per component. Joining the picked ways is only
+//O(components) per round and is done on this thread. The order of the ways is strict,
+//so the forest is the same one Kruskal finds.
+std::vector<bool> Datastructures::boruvka_forest() const
+{
+    std::size_t crossroads = crossroads_vector.size();
+    unsigned int threads = thread_count();
+    Union_find components;
+    components.reset(crossroads);
+    std::vector<int> label(crossroads);
+    for (std::size_t i = 0; i < crossroads; ++i) {
+        label[i] = i;
+    }
+    std::vector<std::atomic<int>> cheapest(crossroads);
+    std::vector<bool> keep(ways_vector.size(), false);
+
+    //every thread owns a fixed slice of the ways and drops the ones that have become
+    //internal to a component from it, live_end tells how much of the slice is left
+    std::vector<int> live(ways_vector.size());
+    for (std::size_t i = 0; i < live.size(); ++i) {
+        live[i] = i;
+    }
+    threads = std::max(1u, std::min<unsigned int>(threads, live.size()));
+    std::size_t slice = (live.size() + threads - 1) / threads;
+    std::vector<std::size_t> live_end(threads);
+    for (unsigned int t = 0; t < threads; ++t) {
+        live_end[t] = std::min(live.size(), (t + 1) * slice);
+    }
+
+    while (true) {
+        parallel_chunks(crossroads, threads, [&](std::size_t begin, std::size_t end, unsigned int) {
+            for (std::size_t i = begin; i < end; ++i) {
+                cheapest[i].store(-1, std::memory_order_relaxed);
+            }
+        });
+
+        std::atomic<bool> any_left(false);
+        //one chunk per thread, each works on the slice of its thread number
+        parallel_chunks(threads, threads, [&](std::size_t, std::size_t, unsigned int thread) {
+            std::size_t slice_begin = std::min(live.size(), thread * slice);
+            std::size_t kept = slice_begin;
+            for (std::size_t i = slice_begin; i < live_end[thread]; ++i) {
+                int way_index = live[i];
+                Way const& way = ways_vector[way_index];
+                int ends[2] = {label[way.start_ver], label[way.end_ver]};
+                if (ends[0] == ends[1]) {
+                    continue;
+                }
+                live[kept++] = way_index;
+                for (int component : ends) {
+                    int current = cheapest[component].load(std::memory_order_relaxed);
+                    while ((current < 0 || shorter_way(way_index, current))
+                           && !cheapest[component].compare_exchange_weak(current, way_index)) {
+                    }
+                }
+            }
+            live_end[thread] = kept;
+            if (kept > slice_begin) {
+                any_left = true;
+            }
+        });
+        if (!any_left) {
+            break;
+        }
+
+        for (std::size_t i = 0; i < crossroads; ++i) {
+            int way_index = cheapest[i].load(std::memory_order_relaxed);
+            if (way_index >= 0 && components.unite(ways_vector[way_index].start_ver, ways_vector[way_index].end_ver)) {
+                keep[way_index] = true;
+            }
+        }
+        //compress once here so that the parallel relabelling only reads the parents
+        for (std::size_t i = 0; i < crossroads; ++i) {
+            components.find(i);
+        }
+        parallel_chunks(crossroads, threads, [&](std::size_t begin, std::size_t end, unsigned int) {
+            for (std::size_t i = begin; i < end; ++i) {
+                label[i] = components.parent[i];
+            }
+        });
+    }
+    return keep;
+}
+
+//Gives the crossroads new ids in the order of the Hilbert curve over their positions and
+//sorts the ways by their lower end, so neighbours on the map are neighbours in
+//crossroads_vector, ways_vector and the coord buffer. Landmark tables are permuted.
+void Datastructures::renumber_crossroads()
+{
+    std::size_t count = crossroads_vector.size();
+    if (count == 0) {
+        return;
+    }
+    long long int minx = std::numeric_limits<int>::max();
+    long long int miny = std::numeric_limits<int>::max();
+    for (Crossroad const& crossroad : crossroads_vector) {
+        minx = std::min<long long int>(minx, crossroad.position.x);
+        miny = std::min<long long int>(miny, crossroad.position.y);
+    }
+    std::vector<std::pair<std::uint64_t, int>> curve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        Coord const& xy = crossroads_vector[i].position;
+        curve[i] = {hilbert_index(xy.x - minx, xy.y - miny), static_cast<int>(i)};
+    }
+    std::sort(curve.begin(), curve.end());
+    std::vector<int> new_id(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        new_id[curve[i].second] = i;
+    }
+
+    //ties keep their old order through the index in the pair
+    std::vector<std::pair<int, int>> way_order(ways_vector.size());
+    for (std::size_t i = 0; i < ways_vector.size(); ++i) {
+        Way const& way = ways_vector[i];
+        way_order[i] = {std::min(new_id[way.start_ver], new_id[way.end_ver]), static_cast<int>(i)};
+    }
+    std::sort(way_order.begin(), way_order.end());
+    std::vector<int> new_index(ways_vector.size());
+    std::vector<Way> ways;
+    ways.reserve(ways_vector.size());
+    for (std::size_t i = 0; i < way_order.size(); ++i) {
+        new_index[way_order[i].second] = i;
+        ways.push_back(std::move(ways_vector[way_order[i].second]));
+    }
+    ways_vector.swap(ways);
+    compact_way_coords();
+    for (std::size_t i = 0; i < ways_vector.size(); ++i) {
+        Way& way = ways_vector[i];
+        way.start_ver = new_id[way.start_ver];
+        way.end_ver = new_id[way.end_ver];
+        wayID_index_map[way.id] = i;
+    }
+
+    std::vector<Crossroad> crossroads(count);
+    for (std::size_t old = 0; old < count; ++old) {
+        Crossroad& crossroad = crossroads[new_id[old]];
+        crossroad = std::move(crossroads_vector[old]);
+        for (int& way_index : crossroad.way_indexes) {
+            way_index = new_index[way_index];
+        }
+        std::sort(crossroad.way_indexes.begin(), crossroad.way_indexes.end());
+        coord_crossroad_map[crossroad.position] = new_id[old];
+    }
+    crossroads_vector.swap(crossroads);
+
+    for (int& landmark : landmarks) {
+        landmark = new_id[landmark];
+    }
+    if (!landmarks_stale) {
+        for (std::vector<std::uint32_t>& row : landmark_dist) {
+            std::vector<std::uint32_t> permuted(count, LANDMARK_UNREACHABLE);
+            for (std::size_t old = 0; old < row.size(); ++old) {
+                permuted[new_id[old]] = row[old];
+            }
+            row.swap(permuted);
+        }
+    }
+    components_stale = true;
+    routing_changed();
+}
+
+//Recreates the id index and the crossroads after ways_vector was changed in bulk.
+//Crossroads that have no ways left disappear, landmarks are kept by position.
+void Datastructures::rebuild_way_graph()
+{
+    std::vector<Coord> landmark_coords;
+    for (int landmark : landmarks) {
+        landmark_coords.push_back(crossroads_vector[landmark].position);
+    }
+
+    wayID_index_map.clear();
+    coord_crossroad_map.clear();
+    crossroads_vector.clear();
+    for (std::size_t i = 0; i < ways_vector.size(); ++i) {
+        Way& way = ways_vector[i];
+        wayID_index_map.insert({way.id, static_cast<int>(i)});
+        Coord const* coords = coords_of(way);
+        way.start_ver = add_crossroad(coords[0]);
+        way.end_ver = add_crossroad(coords[way.coords_count - 1]);
+        crossroads_vector[way.start_ver].way_indexes.push_back(i);
+        if (way.end_ver != way.start_ver) {
+            crossroads_vector[way.end_ver].way_indexes.push_back(i);
+        }
+    }
+
+    landmarks.clear();
+    for (Coord landmark : landmark_coords) {
+        int id = crossroad_id(landmark);
+        if (id >= 0) {
+            landmarks.push_back(id);
+        }
+    }
+    landmarks_stale = !landmarks.empty();
+    components_stale = true;
+    routing_changed();
+}
+
+void Datastructures::Route_scratch::next_query(std::size_t crossroads)
+{
+    //grow only when the graph has grown, old entries are made stale by the stamp
+    if (seen[0].size() < crossroads) {
+        for (int side = 0; side < 2; ++side) {
+            seen[side].resize(crossroads, 0);
+            parent_way[side].resize(crossroads, -1);
+            dist[side].resize(crossroads, 0);
+            queue[side].reset(crossroads);
+        }
+    }
+    ++stamp;
+    //after a wraparound old stamps could look valid again, so start over from zero
+    if (stamp == 0) {
+        for (int side = 0; side < 2; ++side) {
+            std::fill(seen[side].begin(), seen[side].end(), 0);
+        }
+        stamp = 1;
+    }
+}
+
+int Datastructures::crossroad_id(Coord xy) const
+{
+    auto iter = coord_crossroad_map.find(xy);
+    if (iter == coord_crossroad_map.end()) {
+        return -1;
+    }
+    return iter->second;
+}
+
+int Datastructures::add_crossroad(Coord xy)
+{
+    auto iter = coord_crossroad_map.find(xy);
+    if (iter != coord_crossroad_map.end()) {
+        return iter->second;
+    }
+    int id = crossroads_vector.size();
+    crossroads_vector.push_back({xy, {}});
+    coord_crossroad_map.insert({xy, id});
+    return id;
+}
+
+int Datastructures::other_end(int way_index, int crossroad) const
+{
+    Way const& way = ways_vector[way_index];
+    return way.start_ver == crossroad ? way.end_ver : way.start_ver;
+}
+
+//plain BFS from "from", returns "to" if it was reached and -1 otherwise.
+int Datastructures::bfs_route(int from, int to, Route_scratch& scratch) const
+{
+    unsigned int stamp = scratch.stamp;
+    Crossroad_queue& queue = scratch.queue[0];
+    queue.reset(crossroads_vector.size());
+    scratch.seen[0][from] = stamp;
+    scratch.parent_way[0][from] = -1;
+    queue.push(from);
+
+    while (!queue.empty()) {
+        int current = queue.pop();
+        if (current == to) {
+            return to;
+        }
+        for (int way_index : crossroads_vector[current].way_indexes) {
+            int next = other_end(way_index, current);
+            if (scratch.seen[0][next] != stamp) {
+                scratch.seen[0][next] = stamp;
+                scratch.parent_way[0][next] = way_index;
+                queue.push(next);
+            }
+        }
+    }
+    return -1;
+}
+
+//BFS from both ends, one whole level at a time from the smaller frontier. Between
+//levels a queue holds exactly its side's frontier. The first crossroad reached by both
+//searches lies on a route with the least crossroads, so it is returned as the meeting
+//point. -1 if the searches never meet.
+int Datastructures::bfs_route_bidirectional(int from, int to, Route_scratch& scratch) const
+{
+    unsigned int stamp = scratch.stamp;
+    int ends[2] = {from, to};
+    for (int side = 0; side < 2; ++side) {
+        scratch.queue[side].reset(crossroads_vector.size());
+        scratch.queue[side].push(ends[side]);
+        scratch.seen[side][ends[side]] = stamp;
+        scratch.parent_way[side][ends[side]] = -1;
+    }
+    if (from == to) {
+        return from;
+    }
+
+    while (!scratch.queue[0].empty() && !scratch.queue[1].empty()) {
+        int side = scratch.queue[0].size() <= scratch.queue[1].size() ? 0 : 1;
+        Crossroad_queue& queue = scratch.queue[side];
+        std::vector<unsigned int>& seen = scratch.seen[side];
+        std::vector<unsigned int> const& seen_other = scratch.seen[1-side];
+
+        for (std::size_t level = queue.size(); level > 0; --level) {
+            int current = queue.pop();
+            for (int way_index : crossroads_vector[current].way_indexes) {
+                int next = other_end(way_index, current);
+                if (seen[next] == stamp) {
+                    continue;
+                }
+                seen[next] = stamp;
+                scratch.parent_way[side][next] = way_index;
+                if (seen_other[next] == stamp) {
+                    return next;
+                }
+                queue.push(next);
+            }
+        }
+    }
+    return -1;
+}
+
+//Dijkstra from "from" with a lazy-deletion binary heap, stops when "to" is settled.
+int Datastructures::dijkstra_route(int from, int to, Route_scratch& scratch) const
+{
+    unsigned int stamp = scratch.stamp;
+    std::vector<std::pair<Distance, int>>& heap = scratch.heap[0];
+    std::vector<Distance>& dist = scratch.dist[0];
+    auto heap_comp = std::greater<std::pair<Distance, int>>();
+
+    heap.clear();
+    scratch.seen[0][from] = stamp;
+    scratch.parent_way[0][from] = -1;
+    dist[from] = 0;
+    heap.push_back({0, from});
+
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), heap_comp);
+        auto [current_dist, current] = heap.back();
+        heap.pop_back();
+        if (current_dist > dist[current]) {
+            continue;
+        }
+        if (current == to) {
+            return to;
+        }
+        for (int way_index : crossroads_vector[current].way_indexes) {
+            int next = other_end(way_index, current);
+            Distance next_dist = current_dist + ways_vector[way_index].waylength;
+            if (scratch.seen[0][next] != stamp || next_dist < dist[next]) {
+                scratch.seen[0][next] = stamp;
+                scratch.parent_way[0][next] = way_index;
+                dist[next] = next_dist;
+                heap.push_back({next_dist, next});
+                std::push_heap(heap.begin(), heap.end(), heap_comp);
+            }
+        }
+    }
+    return -1;
+}
+
+//Attaches every place to its nearest way point for the current graph.
+void Datastructures::attach_places()
+{
+    if (segments_stale) {
+        rebuild_segment_index();
+    }
+    place_snaps.clear();
+    crossroad_places.assign(crossroads_vector.size(), {});
+    place_snaps.reserve(placeID_coord_map.size());
+    for (auto const& [id, xy] : placeID_coord_map) {
+        attach_place(id, xy);
+    }
+    place_snaps_epoch = graph_epoch;
+}
+
+//A place in the middle of a way is listed at both ends of the way, at a crossroad
+//only there.
+void Datastructures::attach_place(PlaceID id, Coord xy)
+{
+    if (way_segments.empty()) {
+        return;
+    }
+    Snap_point point = snap(xy);
+    place_snaps[id] = point;
+    if (point.crossroad >= 0) {
+        crossroad_places[point.crossroad].push_back({id, 0});
+        return;
+    }
+    Way const& way = ways_vector[point.way_index];
+    crossroad_places[way.start_ver].push_back({id, point.offset});
+    crossroad_places[way.end_ver].push_back({id, way.waylength - point.offset});
+}
+
+void Datastructures::detach_place(PlaceID id)
+{
+    auto iter = place_snaps.find(id);
+    if (iter == place_snaps.end()) {
+        return;
+    }
+    if (place_snaps_epoch == graph_epoch) {
+        Snap_point const& point = iter->second;
+        Way const& way = ways_vector[point.way_index];
+        for (int crossroad : {point.crossroad, way.start_ver, way.end_ver}) {
+            if (crossroad < 0) {
+                continue;
+            }
+            auto& places = crossroad_places[crossroad];
+            places.erase(std::remove_if(places.begin(), places.end(),
+                                        [id](std::pair<PlaceID, Distance> const& place) { return place.first == id; }),
+                         places.end());
+        }
+    }
+    place_snaps.erase(iter);
+}
+
+//Nearest way point of the place, nullptr if there are no ways. Reattaches all of the
+//places first if the ways have changed since they were attached.
+Datastructures::Snap_point const* Datastructures::place_snap(PlaceID id)
+{
+    if (place_snaps_epoch != graph_epoch) {
+        attach_places();
+    }
+    auto iter = place_snaps.find(id);
+    if (iter == place_snaps.end()) {
+        return nullptr;
+    }
+    return &iter->second;
+}
+
+Coord const* Datastructures::coords_of(Way const& way) const
+{
+    return way_coord_buffer.data() + way.coords_begin;
+}
+
+//Copies the coords of the live ways into a new buffer in ways_vector order, which
+//drops the holes and keeps the coords of neighbouring ways next to each other.
+void Datastructures::compact_way_coords()
+{
+    std::vector<Coord> compacted;
+    std::vector<Distance> compacted_offsets;
+    compacted.reserve(way_coord_buffer.size() - way_coord_holes);
+    compacted_offsets.reserve(way_coord_buffer.size() - way_coord_holes);
+    for (Way& way : ways_vector) {
+        Coord const* coords = coords_of(way);
+        Distance const* offsets = &way_coord_offsets[way.coords_begin];
+        way.coords_begin = compacted.size();
+        compacted.insert(compacted.end(), coords, coords + way.coords_count);
+        compacted_offsets.insert(compacted_offsets.end(), offsets, offsets + way.coords_count);
+    }
+    way_coord_buffer.swap(compacted);
+    way_coord_offsets.swap(compacted_offsets);
+    way_coord_holes = 0;
+}
+
+//Collects the segments of all ways and builds the bounding box tree over them.
+void Datastructures::rebuild_segment_index()
+{
+    way_segments.clear();
+    segment_nodes.clear();
+    for (std::size_t i = 0; i < ways_vector.size(); ++i) {
+        Coord const* coords = coords_of(ways_vector[i]);
+        for (std::size_t j = 0; j + 1 < ways_vector[i].coords_count; ++j) {
+            way_segments.push_back({{coords[j], coords[j+1]}, static_cast<int>(i), static_cast<int>(j)});
+        }
+    }
+    if (!way_segments.empty()) {
+        segment_nodes.reserve(2 * way_segments.size() / SEGMENT_LEAF_SIZE + 1);
+        build_segment_node(0, way_segments.size());
+    }
+    segments_stale = false;
+}
+
+//Builds the subtree over way_segments[begin .. end) by splitting at the median of the
+//segment midpoints along the longer side of the box. Returns the index of its root.
+int Datastructures::build_segment_node(int begin, int end)
+{
+    int index = segment_nodes.size();
+    Segment_node node = {std::numeric_limits<int>::max(), std::numeric_limits<int>::max(),
+                         std::numeric_limits<int>::min(), std::numeric_limits<int>::min(), begin, end, {-1, -1}};
+    for (int i = begin; i < end; ++i) {
+        for (Coord const& xy : way_segments[i].ends) {
+            node.minx = std::min(node.minx, xy.x);
+            node.miny = std::min(node.miny, xy.y);
+            node.maxx = std::max(node.maxx, xy.x);
+            node.maxy = std::max(node.maxy, xy.y);
+        }
+    }
+    segment_nodes.push_back(node);
+    if (end - begin <= SEGMENT_LEAF_SIZE) {
+        return index;
+    }
+
+    bool by_x = static_cast<long long int>(node.maxx) - node.minx >= static_cast<long long int>(node.maxy) - node.miny;
+    int middle = begin + (end - begin) / 2;
+    std::nth_element(way_segments.begin() + begin, way_segments.begin() + middle, way_segments.begin() + end,
+                     [by_x](Way_segment const& a, Way_segment const& b) {
+        //doubled midpoints, no need to divide
+        if (by_x) {
+            return static_cast<long long int>(a.ends[0].x) + a.ends[1].x < static_cast<long long int>(b.ends[0].x) + b.ends[1].x;
+        }
+        return static_cast<long long int>(a.ends[0].y) + a.ends[1].y < static_cast<long long int>(b.ends[0].y) + b.ends[1].y;
+    });
+    int left = build_segment_node(begin, middle);
+    int right = build_segment_node(middle, end);
+    segment_nodes[index].children[0] = left;
+    segment_nodes[index].children[1] = right;
+    return index;
+}
+
+//Nearest point on any way segment. Goes down the box tree nearer child first and skips
+//every box that is further away than the best segment so far. On a tie a way end wins,
+//so a point at a crossroad isn't put in the middle of another way through it.
+Datastructures::Snap_point Datastructures::snap(Coord xy) const
+{
+    double px = xy.x;
+    double py = xy.y;
+    auto box_distance = [px, py](Segment_node const& node) {
+        double dx = std::max({node.minx - px, 0.0, px - node.maxx});
+        double dy = std::max({node.miny - py, 0.0, py - node.maxy});
+        return dx * dx + dy * dy;
+    };
+
+    double best = std::numeric_limits<double>::infinity();
+    bool best_at_end = false;
+    int best_segment = 0;
+    double best_x = 0;
+    double best_y = 0;
+    //a child is pushed only after its parent was popped, so the depth bounds the stack
+    int stack[128];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        Segment_node const& node = segment_nodes[stack[--top]];
+        double node_distance = box_distance(node);
+        if (node_distance > best || (node_distance == best && best_at_end)) {
+            continue;
+        }
+        if (node.children[0] < 0) {
+            for (int i = node.begin; i < node.end; ++i) {
+                Coord const& a = way_segments[i].ends[0];
+                Coord const& b = way_segments[i].ends[1];
+                double abx = static_cast<double>(b.x) - a.x;
+                double aby = static_cast<double>(b.y) - a.y;
+                double length2 = abx * abx + aby * aby;
+                double t = length2 > 0 ? ((px - a.x) * abx + (py - a.y) * aby) / length2 : 0;
+                t = std::min(1.0, std::max(0.0, t));
+                double qx = a.x + t * abx;
+                double qy = a.y + t * aby;
+                double d2 = (qx - px) * (qx - px) + (qy - py) * (qy - py);
+                if (d2 > best || (d2 == best && best_at_end)) {
+                    continue;
+                }
+                bool at_end = (t == 0 && way_segments[i].index == 0)
+                              || (t == 1 && way_segments[i].index + 2
+                                                == static_cast<int>(ways_vector[way_segments[i].way_index].coords_count));
+                if (d2 < best || at_end) {
+                    best = d2;
+                    best_at_end = at_end;
+                    best_segment = i;
+                    best_x = qx;
+                    best_y = qy;
+                }
+            }
+            continue;
+        }
+        int near = node.children[0];
+        int far = node.children[1];
+        if (box_distance(segment_nodes[far]) < box_distance(segment_nodes[near])) {
+            std::swap(near, far);
+        }
+        stack[top++] = far;
+        stack[top++] = near;
+    }
+
+    Way_segment const& segment = way_segments[best_segment];
+    Way const& way = ways_vector[segment.way_index];
+    Snap_point point;
+    point.xy = {static_cast<int>(std::lround(best_x)), static_cast<int>(std::lround(best_y))};
+    point.way_index = segment.way_index;
+    point.crossroad = -1;
+    point.offset = 0;
+    if (point.xy == crossroads_vector[way.start_ver].position) {
+        point.crossroad = way.start_ver;
+        return point;
+    }
+    if (point.xy == crossroads_vector[way.end_ver].position) {
+        point.crossroad = way.end_ver;
+        return point;
+    }
+    //offset of the start of this segment, then the part of this one
+    Coord const* coords = coords_of(way);
+    point.offset = way_coord_offsets[way.coords_begin + segment.index];
+    point.offset += std::min(way_length(coords[segment.index], point.xy),
+                             way_length(coords[segment.index], coords[segment.index + 1]));
+    point.offset = std::min(point.offset, way.waylength);
+    return point;
+}
+
+//Dijkstra between two snapped points. A point in the middle of a way is joined to both
+//ends of its way by the part of the way between them, parent_way -2 marks those.
+std::vector<std::tuple<Coord, WayID, Distance>> Datastructures::snapped_route(Snap_point const& from, Snap_point const& to,
+                                                                              Route_scratch& scratch) const
+{
+    unsigned int stamp = scratch.stamp;
+    std::vector<std::pair<Distance, int>>& heap = scratch.heap[0];
+    std::vector<Distance>& dist = scratch.dist[0];
+    std::vector<int>& parent = scratch.parent_way[0];
+    auto heap_comp = std::greater<std::pair<Distance, int>>();
+    heap.clear();
+
+    auto reach = [&](int node, Distance node_dist, int via) {
+        if (scratch.seen[0][node] != stamp || node_dist < dist[node]) {
+            scratch.seen[0][node] = stamp;
+            dist[node] = node_dist;
+            parent[node] = via;
+            heap.push_back({node_dist, node});
+            std::push_heap(heap.begin(), heap.end(), heap_comp);
+        }
+    };
+
+    Way const& from_way = ways_vector[from.way_index];
+    Way const& to_way = ways_vector[to.way_index];
+    if (from.crossroad >= 0) {
+        reach(from.crossroad, 0, -1);
+    }
+    else {
+        reach(from_way.start_ver, from.offset, -2);
+        reach(from_way.end_ver, from_way.waylength - from.offset, -2);
+    }
+
+    //best_end is the crossroad the route leaves for "to", -1 when it goes straight along
+    //the way both points are on
+    Distance best = std::numeric_limits<Distance>::max();
+    int best_end = -1;
+    if (from.crossroad < 0 && to.crossroad < 0 && from.way_index == to.way_index) {
+        best = std::abs(from.offset - to.offset);
+    }
+
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), heap_comp);
+        auto [current_dist, current] = heap.back();
+        heap.pop_back();
+        if (current_dist > dist[current]) {
+            continue;
+        }
+        if (current_dist >= best) {
+            break;
+        }
+        if (to.crossroad >= 0) {
+            if (current == to.crossroad) {
+                best = current_dist;
+                best_end = current;
+                break;
+            }
+        }
+        else {
+            Distance through = std::numeric_limits<Distance>::max();
+            if (current == to_way.start_ver) {
+                through = current_dist + to.offset;
+            }
+            if (current == to_way.end_ver) {
+                through = std::min(through, current_dist + to_way.waylength - to.offset);
+            }
+            if (through < best) {
+                best = through;
+                best_end = current;
+            }
+        }
+        for (int way_index : crossroads_vector[current].way_indexes) {
+            reach(other_end(way_index, current), current_dist + ways_vector[way_index].waylength, way_index);
+        }
+    }
+    if (best == std::numeric_limits<Distance>::max()) {
+        return {};
+    }
+
+    std::vector<std::tuple<Coord, WayID, Distance>> result;
+    if (best_end < 0) {
+        result.emplace_back(from.xy, from_way.id, 0);
+        result.emplace_back(to.xy, NO_WAY, best);
+        return result;
+    }
+    std::vector<int>& way_path = scratch.way_path;
+    way_path.clear();
+    int node = best_end;
+    while (parent[node] >= 0) {
+        way_path.push_back(parent[node]);
+        node = other_end(parent[node], node);
+    }
+    std::reverse(way_path.begin(), way_path.end());
+
+    if (from.crossroad < 0) {
+        result.emplace_back(from.xy, from_way.id, 0);
+    }
+    Distance travelled = dist[node];
+    for (int way_index : way_path) {
+        result.emplace_back(crossroads_vector[node].position, ways_vector[way_index].id, travelled);
+        travelled += ways_vector[way_index].waylength;
+        node = other_end(way_index, node);
+    }
+    if (to.crossroad < 0) {
+        result.emplace_back(crossroads_vector[node].position, to_way.id, travelled);
+        result.emplace_back(to.xy, NO_WAY, best);
+    }
+    else {
+        result.emplace_back(crossroads_vector[node].position, NO_WAY, travelled);
+    }
+    return result;
+}
+
+//Dijkstra for the spur routes of route_alternatives. Crossroads marked in seen[1] and
+//the ways in blocked_ways are left out. Returns "to" if it was reached and -1 otherwise.
+int Datastructures::spur_dijkstra(int from, int to, std::vector<int> const& blocked_ways, Route_scratch& scratch) const
+{
+    unsigned int stamp = scratch.stamp;
+    std::vector<std::pair<Distance, int>>& heap = scratch.heap[0];
+    std::vector<Distance>& dist = scratch.dist[0];
+    auto heap_comp = std::greater<std::pair<Distance, int>>();
+
+    heap.clear();
+    scratch.seen[0][from] = stamp;
+    scratch.parent_way[0][from] = -1;
+    dist[from] = 0;
+    heap.push_back({0, from});
+
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), heap_comp);
+        auto [current_dist, current] = heap.back();
+        heap.pop_back();
+        if (current_dist > dist[current]) {
+            continue;
+        }
+        if (current == to) {
+            return to;
+        }
+        for (int way_index : crossroads_vector[current].way_indexes) {
+            int next = other_end(way_index, current);
+            if (scratch.seen[1][next] == stamp
+                || std::find(blocked_ways.begin(), blocked_ways.end(), way_index) != blocked_ways.end()) {
+                continue;
+            }
+            Distance next_dist = current_dist + ways_vector[way_index].waylength;
+            if (scratch.seen[0][next] != stamp || next_dist < dist[next]) {
+                scratch.seen[0][next] = stamp;
+                scratch.parent_way[0][next] = way_index;
+                dist[next] = next_dist;
+                heap.push_back({next_dist, next});
+                std::push_heap(heap.begin(), heap.end(), heap_comp);
+            }
+        }
+    }
+    return -1;
+}
+
+//Dijkstra from "from" that stops at the first crossroad further than budget. Fills
+//settled with the crossroads within the budget in the order they were settled, marks
+//them in seen[1] and leaves their distances in dist[0].
+void Datastructures::bounded_dijkstra(int from, Distance budget, std::vector<int>& settled, Route_scratch& scratch) const
+{
+    scratch.next_query(crossroads_vector.size());
+    unsigned int stamp = scratch.stamp;
+    std::vector<std::pair<Distance, int>>& heap = scratch.heap[0];
+    std::vector<Distance>& dist = scratch.dist[0];
+    auto heap_comp = std::greater<std::pair<Distance, int>>();
+    heap.clear();
+    settled.clear();
+    scratch.seen[0][from] = stamp;
+    dist[from] = 0;
+    heap.push_back({0, from});
+
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), heap_comp);
+        auto [current_dist, current] = heap.back();
+        heap.pop_back();
+        if (current_dist > budget) {
+            break;
+        }
+        if (current_dist > dist[current] || scratch.seen[1][current] == stamp) {
+            continue;
+        }
+        scratch.seen[1][current] = stamp;
+        settled.push_back(current);
+        for (int way_index : crossroads_vector[current].way_indexes) {
+            int next = other_end(way_index, current);
+            Distance next_dist = current_dist + ways_vector[way_index].waylength;
+            //nothing past the budget can lead back into it
+            if (next_dist > budget) {
+                continue;
+            }
+            if (scratch.seen[0][next] != stamp || next_dist < dist[next]) {
+                scratch.seen[0][next] = stamp;
+                dist[next] = next_dist;
+                heap.push_back({next_dist, next});
+                std::push_heap(heap.begin(), heap.end(), heap_comp);
+            }
+        }
+    }
+}
+
+//Dijkstra from "from" that stops as soon as all of the targets are settled, instead of
+//running a separate search for each of them. seen[1] marks the targets still unsettled.
+//Fills row[i] with the distance to targets[i], targets that aren't crossroads are -1.
+void Datastructures::dijkstra_to_targets(int from, std::vector<int> const& targets, std::vector<Distance>& row,
+                                         Route_scratch& scratch) const
+{
+    scratch.next_query(crossroads_vector.size());
+    unsigned int stamp = scratch.stamp;
+    std::size_t pending = 0;
+    for (int target : targets) {
+        if (target >= 0 && scratch.seen[1][target] != stamp) {
+            scratch.seen[1][target] = stamp;
+            ++pending;
+        }
+    }
+
+    std::vector<std::pair<Distance, int>>& heap = scratch.heap[0];
+    std::vector<Distance>& dist = scratch.dist[0];
+    auto heap_comp = std::greater<std::pair<Distance, int>>();
+    heap.clear();
+    scratch.seen[0][from] = stamp;
+    dist[from] = 0;
+    heap.push_back({0, from});
+
+    while (pending > 0 && !heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), heap_comp);
+        auto [current_dist, current] = heap.back();
+        heap.pop_back();
+        if (current_dist > dist[current]) {
+            continue;
+        }
+        if (scratch.seen[1][current] == stamp) {
+            scratch.seen[1][current] = 0;
+            --pending;
+        }
+        for (int way_index : crossroads_vector[current].way_indexes) {
+            int next = other_end(way_index, current);
+            Distance next_dist = current_dist + ways_vector[way_index].waylength;
+            if (scratch.seen[0][next] != stamp || next_dist < dist[next]) {
+                scratch.seen[0][next] = stamp;
+                dist[next] = next_dist;
+                heap.push_back({next_dist, next});
+                std::push_heap(heap.begin(), heap.end(), heap_comp);
+            }
+        }
+    }
+
+    //every reached target got settled, the rest have no route
+    for (std::size_t i = 0; i < targets.size(); ++i) {
+        int target = targets[i];
+        if (target >= 0 && scratch.seen[0][target] == stamp) {
+            row[i] = dist[target];
+        }
+    }
+}
+
+//Dijkstra from both ends. Always advances the side whose heap top is smaller and
+//keeps the best route found so far through any relaxed way. Stops when the two heap
+//tops together can't beat that route anymore.
+int Datastructures::dijkstra_route_bidirectional(int from, int to, Route_scratch& scratch) const
+{
+    unsigned int stamp = scratch.stamp;
+    auto heap_comp = std::greater<std::pair<Distance, int>>();
+    int ends[2] = {from, to};
+    for (int side = 0; side < 2; ++side) {
+        scratch.heap[side].clear();
+        scratch.heap[side].push_back({0, ends[side]});
+        scratch.seen[side][ends[side]] = stamp;
+        scratch.parent_way[side][ends[side]] = -1;
+        scratch.dist[side][ends[side]] = 0;
+    }
+    if (from == to) {
+        return from;
+    }
+
+    Distance best = std::numeric_limits<Distance>::max();
+    int meet = -1;
+
+    while (true) {
+        //drop stale heap entries so that the tops are real distances
+        for (int side = 0; side < 2; ++side) {
+            std::vector<std::pair<Distance, int>>& heap = scratch.heap[side];
+            while (!heap.empty() && heap.front().first > scratch.dist[side][heap.front().second]) {
+                std::pop_heap(heap.begin(), heap.end(), heap_comp);
+                heap.pop_back();
+            }
+        }
+        if (scratch.heap[0].empty() || scratch.heap[1].empty()) {
+            break;
+        }
+        Distance top0 = scratch.heap[0].front().first;
+        Distance top1 = scratch.heap[1].front().first;
+        if (meet >= 0 && static_cast<long long>(top0) + top1 >= best) {
+            break;
+        }
+
+        int side = top0 <= top1 ? 0 : 1;
+        std::vector<std::pair<Distance, int>>& heap = scratch.heap[side];
+        std::vector<Distance>& dist = scratch.dist[side];
+        std::pop_heap(heap.begin(), heap.end(), heap_comp);
+        auto [current_dist, current] = heap.back();
+        heap.pop_back();
+
+        for (int way_index : crossroads_vector[current].way_indexes) {
+            int next = other_end(way_index, current);
+            Distance next_dist = current_dist + ways_vector[way_index].waylength;
+            if (scratch.seen[side][next] != stamp || next_dist < dist[next]) {
+                scratch.seen[side][next] = stamp;
+                scratch.parent_way[side][next] = way_index;
+                dist[next] = next_dist;
+                heap.push_back({next_dist, next});
+                std::push_heap(heap.begin(), heap.end(), heap_comp);
+            }
+            if (scratch.seen[1-side][next] == stamp && scratch.dist[side][next] + scratch.dist[1-side][next] < best) {
+                best = scratch.dist[side][next] + scratch.dist[1-side][next];
+                meet = next;
+            }
+        }
+    }
+    return meet;
+}
+
+//Turns the parent ways of a finished search into the route format. The part from
+//"from" to "meet" comes from the forward search and the part from "meet" to "to"
+//from the backward one (empty for one-directional searches, where meet == to).
+std::vector<std::tuple<Coord, WayID, Distance>> Datastructures::build_route(int from, int meet, int to,
+                                                                            Route_scratch const& scratch) const
+{
+    std::size_t forward_steps = 0;
+    for (int node = meet; node != from; node = other_end(scratch.parent_way[0][node], node)) {
+        ++forward_steps;
+    }
+    std::size_t backward_steps = 0;
+    for (int node = meet; node != to; node = other_end(scratch.parent_way[1][node], node)) {
+        ++backward_steps;
+    }
+
+    std::vector<std::tuple<Coord, WayID, Distance>> result(forward_steps + backward_steps + 1);
+
+    //forward part is filled backwards, distances are fixed up below
+    std::size_t i = forward_steps;
+    for (int node = meet; node != from; ) {
+        int way_index = scratch.parent_way[0][node];
+        node = other_end(way_index, node);
+        --i;
+        result[i] = std::make_tuple(crossroads_vector[node].position, ways_vector[way_index].id,
+                                    ways_vector[way_index].waylength);
+    }
+    i = forward_steps;
+    for (int node = meet; node != to; ) {
+        int way_index = scratch.parent_way[1][node];
+        result[i] = std::make_tuple(crossroads_vector[node].position, ways_vector[way_index].id,
+                                    ways_vector[way_index].waylength);
+        node = other_end(way_index, node);
+        ++i;
+    }
+    result[i] = std::make_tuple(crossroads_vector[to].position, NO_WAY, 0);
+
+    //turn way lengths into the distance travelled before each step
+    Distance travelled = 0;
+    for (auto& step : result) {
+        Distance length = std::get<2>(step);
+        std::get<2>(step) = travelled;
+        travelled += length;
+    }
+    return result;
+}
+
+std::vector<std::tuple<Coord, WayID, Distance>> Datastructures::build_route_from_ways(int from,
+                                                                                      std::vector<int> const& way_path) const
+{
+    std::vector<std::tuple<Coord, WayID, Distance>> result;
+    result.reserve(way_path.size() + 1);
+    int node = from;
+    Distance travelled = 0;
+    for (int way_index : way_path) {
+        result.emplace_back(crossroads_vector[node].position, ways_vector[way_index].id, travelled);
+        travelled += ways_vector[way_index].waylength;
+        node = other_end(way_index, node);
+    }
+    result.emplace_back(crossroads_vector[node].position, NO_WAY, travelled);
+    return result;
+}
+
+
+
+//Lengths of the count segments between coords[0 .. count], with AVX2 when the processor
+//has it. What is left over is done one segment at a time.
+void Datastructures::segment_lengths(Coord const* coords, std::size_t count, Distance* lengths)
+{
+    std::size_t done = 0;
+#ifdef POLYLINE_AVX2
+    static bool const has_avx2 = __builtin_cpu_supports("avx2");
+    if (has_avx2) {
+        done = segment_lengths_avx2(coords, count, lengths);
+    }
+#endif
+    for (std::size_t i = done; i < count; ++i) {
+        lengths[i] = way_length(coords[i], coords[i+1]);
+    }
+}
+
+//Distance from coords[0] to each of the count coords along the polyline.
+void Datastructures::polyline_offsets(Coord const* coords, std::size_t count, Distance* offsets)
+{
+    if (count == 0) {
+        return;
+    }
+    offsets[0] = 0;
+    segment_lengths(coords, count - 1, offsets + 1);
+    for (std::size_t i = 1; i < count; ++i) {
+        offsets[i] += offsets[i-1];
+    }
+}
 
-int Datastructures::way_length(Coord fromxy, Coord toxy)
+NO_FP_CONTRACT int Datastructures::way_length(Coord fromxy, Coord toxy)
 {
 
     //calculating the length of a route from coord to coord
@@ -12,6 +12,8 @@
 #include <unordered_map>
 #include <map>
 #include <iostream>
+#include <cstdint>
+#include <list>
 
 
 // Types for IDs
@@ -36,6 +38,26 @@ Name const NO_NAME = "!!NO_NAME!!";
 // individual values as PlaceType::SHELTER etc.
 enum class PlaceType { OTHER=0, FIREPIT, SHELTER, PARKING, PEAK, BAY, AREA, NO_TYPE };
 
+// Search strategy used by route_least_crossroads and route_shortest_distance.
+// BIDIRECTIONAL searches from both ends at once and stops when the searches meet.
+enum class RouteSearch { UNIDIRECTIONAL, BIDIRECTIONAL };
+
+// The different route queries, used to tell their results apart
+enum class RouteKind { ANY, LEAST_CROSSROADS, SHORTEST_DISTANCE };
+
+// Counters of the route result cache
+struct RouteCacheStats
+{
+    unsigned long int hits = 0;
+    unsigned long int misses = 0;
+    std::size_t entries = 0;
+    std::size_t limit = 0;
+};
+
+// Minimum spanning forest algorithm used by trim_ways. BORUVKA runs its rounds on
+// the worker threads and gives exactly the same result as KRUSKAL.
+enum class TrimAlgorithm { KRUSKAL, BORUVKA };
+
 // Type for a coordinate (x, y)
 struct Coord
 {
@@ -170,8 +192,8 @@ public:
 
     // Non-compulsory operations
 
-    // Estimate of performance:
-    // Short rationale for estimate:
+    // Estimate of performance: O(p*log(m)), m being the number of way segments
+    // Short rationale for estimate: Every place is attached to its nearest way point.
     void creation_finished();
 
     // Estimate of performance:
@@ -196,48 +218,194 @@ public:
     // Short rationale for estimate: For-loop where we insert n-times is O(n).
     std::vector<WayID> all_ways();
 
-    // Estimate of performance: O(n)
-    // Short rationale for estimate: Checks through ways_vector for ID, then adds it if missing.
+    // Estimate of performance: O(c + e), c being the number of coords and e the cached routes
+    // (amortized, without landmarks)
+    // Short rationale for estimate: Hash lookup of the id, the coords are appended to the shared
+    // buffer and both ends are looked up or added in the crossroad table. The route cache is
+    // walked only when it has routes for the graph before this way, e is 0 otherwise.
     bool add_way(WayID id, std::vector<Coord> coords);
 
-    // Estimate of performance: O(log^n)
-    // Short rationale for estimate: Goes through ways_vector with for loop, has an inner for-loop.
+    // Estimate of performance: O(k), k being the number of ways at xy
+    // Short rationale for estimate: Hash lookup of the crossroad at xy, then one step per way
+    // that starts or ends there.
     std::vector<std::pair<WayID, Coord>> ways_from(Coord xy);
 
-    // Estimate of performance: O(n)
-    // Short rationale for estimate: Again a for-loop going through ways_vector.
+    // Estimate of performance: O(c), c being the number of coords of the way
+    // Short rationale for estimate: Hash lookup of the way, then a copy of its slice of
+    // way_coord_buffer.
     std::vector<Coord> get_way_coords(WayID id);
 
     // Estimate of performance: O(n)
     // Short rationale for estimate: Clearing a vector depends on it's size.
     void clear_ways();
 
-    // Estimate of performance:
-    // Short rationale for estimate:
+    // Estimate of performance: O(p+a+k+c), c being the total number of coordinates
+    // Short rationale for estimate: Every place, area and way is copied once into the
+    // columns of the snapshot, which are then written in one pass.
+    bool save_snapshot(std::string const& filename);
+
+    // Estimate of performance: O(p+a+k+c)
+    // Short rationale for estimate: The file is mapped to memory and its columns are read
+    // in place, with no parsing. Replaces all places, areas and ways, the crossroads are
+    // rebuilt in one pass. Returns false, changing nothing, if the file isn't a snapshot.
+    bool load_snapshot(std::string const& filename);
+
+    // Estimate of performance: O(n+k), k being the number of ways
+    // Short rationale for estimate: Same BFS as route_least_crossroads, any route will do.
+    // A repeated query is answered from the route cache in O(route length).
     std::vector<std::tuple<Coord, WayID, Distance>> route_any(Coord fromxy, Coord toxy);
 
     // Non-compulsory operations
 
-    // Estimate of performance:
-    // Short rationale for estimate:
+    // Estimate of performance: O(d + k*a*log(a) + c*r), d being the number of ways at the way's
+    // crossroads, a the crossroads whose landmark distances change, c*r the cached route steps
+    // Short rationale for estimate: The last way is swapped into the hole, so only the
+    // crossroads of the two ways are touched. Same for a crossroad left without ways. Only
+    // the landmark distances behind the way are recomputed, and only cached routes that
+    // used the way are dropped.
     bool remove_way(WayID id);
 
-    // Estimate of performance:
-    // Short rationale for estimate:
+    // Estimate of performance: O(n+k), k being the number of ways
+    // Short rationale for estimate: BFS visits every crossroad and way at most once.
+    // Bidirectional mode usually explores far fewer of them. Cached like route_any.
     std::vector<std::tuple<Coord, WayID, Distance>> route_least_crossroads(Coord fromxy, Coord toxy);
 
-    // Estimate of performance:
-    // Short rationale for estimate:
+    // Estimate of performance: O(n+k), k being the number of ways
+    // Short rationale for estimate: DFS touches each crossroad and way of the component at
+    // most once and stops at the first way back to a crossroad still on the stack.
     std::vector<std::tuple<Coord, WayID>> route_with_cycle(Coord fromxy);
 
-    // Estimate of performance:
-    // Short rationale for estimate:
+    // Estimate of performance: O(a(n)), O(n+k) right after ways were removed
+    // Short rationale for estimate: Component labels are kept in a union-find that add_way
+    // updates, removals only mark it stale and the next query rebuilds it.
+    bool are_connected(Coord fromxy, Coord toxy);
+
+    // Estimate of performance: O(a(n)), O(n+k) right after ways were removed
+    // Short rationale for estimate: The union-find keeps the size of each component at its
+    // root. Returns how many crossroads are connected to xy, itself included, 0 if xy
+    // isn't a crossroad.
+    int component_size(Coord xy);
+
+    // Estimate of performance: O((n+k)log(n))
+    // Short rationale for estimate: Dijkstra with a binary heap, every way is relaxed at most
+    // once per direction. Cached like route_any.
     std::vector<std::tuple<Coord, WayID, Distance>> route_shortest_distance(Coord fromxy, Coord toxy);
 
-    // Estimate of performance:
-    // Short rationale for estimate:
+    // Estimate of performance: O(q*(n+k)log(n)/threads), q being the number of queries
+    // Short rationale for estimate: Each query is the same search as the single route
+    // query of that kind, the worker threads share the graph and have their own scratch.
+    // Results are in the order of the queries and bypass the route cache.
+    std::vector<std::vector<std::tuple<Coord, WayID, Distance>>> route_batch(std::vector<std::pair<Coord, Coord>> queries,
+                                                                             RouteKind kind);
+
+    // Estimate of performance: O(log(m)), m being the number of way segments
+    // Short rationale for estimate: Nearest segment from a bounding box tree over all way
+    // segments, the tree is rebuilt in O(m*log(m)) after ways change. Returns the nearest
+    // point on any way rounded to integers, the way and the distance along it from its start.
+    std::tuple<Coord, WayID, Distance> snap_to_way(Coord xy);
+
+    // Estimate of performance: O((n+k)log(n))
+    // Short rationale for estimate: Both points are snapped to their nearest way, then a
+    // Dijkstra starts from both ends of the first way. The first and last steps of the
+    // route are the snapped points, their distances include the partial ways.
+    std::vector<std::tuple<Coord, WayID, Distance>> route_between_points(Coord fromxy, Coord toxy);
+
+    // Estimate of performance: O((n+k)log(n))
+    // Short rationale for estimate: Places are attached to their nearest way point in
+    // creation_finished, so only the route search is left. Shortest routes start and end
+    // at the attached points, the other kinds at the nearer end of the attached ways.
+    std::vector<std::tuple<Coord, WayID, Distance>> route_between_places(PlaceID fromid, PlaceID toid, RouteKind kind);
+
+    // Estimate of performance: O((r+k)log(r)), r being the crossroads closer than the k:th place
+    // Short rationale for estimate: Dijkstra from the start crossroad over the places attached
+    // to each crossroad, stops once count places of the type are known to be the nearest.
+    // NO_TYPE matches any type. Result is (place, road distance) in increasing distance.
+    std::vector<std::pair<PlaceID, Distance>> nearest_by_road(Coord fromxy, PlaceType type, int count);
+
+    // Estimate of performance: O(s*(n+k)log(n)/threads), s being the number of sources
+    // Short rationale for estimate: One Dijkstra per source that stops when every target
+    // is settled, sources are split between the worker threads. Row i holds the distances
+    // from sources[i], NO_DISTANCE where there is no route.
+    std::vector<std::vector<Distance>> distance_matrix(std::vector<Coord> sources, std::vector<Coord> targets);
+
+    // Estimate of performance: O(r*l*(n+k)log(n)), r routes of at most l crossroads
+    // Short rationale for estimate: Yen's algorithm, one Dijkstra per spur crossroad of each
+    // route found. Spurs before the point where a route left its parent were already tried
+    // and are skipped. Returns up to count loopless routes, shortest first.
+    std::vector<std::vector<std::tuple<Coord, WayID, Distance>>> route_alternatives(Coord fromxy, Coord toxy, int count);
+
+    // Estimate of performance: O((r+k)log(r)), r being the number of crossroads within the budget
+    // Short rationale for estimate: Dijkstra that stops at the first crossroad past the budget,
+    // so only the reachable part of the map is touched. Result is in increasing distance.
+    std::vector<std::pair<Coord, Distance>> reachable_within(Coord fromxy, Distance budget);
+
+    // Estimate of performance: O((r+k)log(r) + q log(q)), q being the places attached to the reached crossroads
+    // Short rationale for estimate: reachable_within, then the places attached to each reached
+    // crossroad are checked. A place counts when its nearest way point is within the budget.
+    std::vector<PlaceID> places_reachable_within(Coord fromxy, Distance budget);
+
+    // Estimate of performance: O(k*a(n)), k being the number of ways
+    // Short rationale for estimate: Ways are radix sorted by length and Kruskal keeps the
+    // ones that join two union-find sets. Returns the total length of the remaining ways.
+    // Boruvka does O(log(n)) rounds of O(k/threads) each.
     Distance trim_ways();
 
+    // Estimate of performance: O(k)
+    // Short rationale for estimate: Copies the ids removed by the last trim_ways.
+    std::vector<WayID> trimmed_ways();
+
+    // Estimate of performance: O(1)
+    // Short rationale for estimate: Returns a member.
+    Distance trimmed_length();
+
+    // Estimate of performance: O(1)
+    // Short rationale for estimate: Only stores the algorithm for the next trim_ways.
+    void set_trim_algorithm(TrimAlgorithm algorithm);
+
+    // Estimate of performance: O(1)
+    // Short rationale for estimate: Only stores the count. 0 means one thread per core.
+    void set_worker_threads(unsigned int threads);
+
+    // Estimate of performance: O(n), n being the number of entries dropped
+    // Short rationale for estimate: Least recently used routes are dropped down to the new
+    // limit. 0 turns the cache off, which is also the default.
+    void set_route_cache_size(std::size_t entries);
+
+    // Estimate of performance: O(1)
+    // Short rationale for estimate: Copies the counters.
+    RouteCacheStats route_cache_stats();
+
+    // Estimate of performance: O(1)
+    // Short rationale for estimate: Only stores the mode, next route query uses it.
+    void set_route_search(RouteSearch mode);
+
+    // Estimate of performance: O(1)
+    // Short rationale for estimate: Returns a member.
+    RouteSearch get_route_search();
+
+    // Estimate of performance: O(1)
+    // Short rationale for estimate: Only stores the flag. When on, route_shortest_distance
+    // searches the graph of junctions, where chains of two-way crossroads are single edges.
+    // The junction graph is rebuilt in O(n+k) on the first query after ways change.
+    void set_chain_compression(bool enabled);
+
+    // Estimate of performance: O(1)
+    // Short rationale for estimate: Only stores the flag. When on, creation_finished renumbers
+    // the crossroads along a Hilbert curve over their coordinates in O((n+w)log(n+w)), so
+    // crossroads that are near each other on the map are near each other in memory.
+    void set_hilbert_order(bool enabled);
+
+    // Estimate of performance: O(n*w), w being the cost of the local witness searches
+    // Short rationale for estimate: Every crossroad is contracted once, and each contraction
+    // runs a bounded Dijkstra from each of its neighbours. Returns the number of shortcuts.
+    int prepare_routing();
+
+    // Estimate of performance: O(k*(n+w)log(n)), k being the number of landmarks
+    // Short rationale for estimate: One full Dijkstra per landmark. Picks the landmarks and
+    // returns how many were picked, route_shortest_distance then uses A* with them.
+    // add_way and remove_way repair the tables instead of recomputing them.
+    int prepare_landmarks(int count);
+
 private:
     // Add stuff needed for your class implementation here
 
@@ -257,30 +425,18 @@ private:
     //yeah ended up not using this at all maybe it would have been neater but
 
 
-    struct Way_node {
-        Coord position;
-        int val;
-        bool visited = false;
-        struct Way_node *next;
-        struct Way_node *prev;
-
-    };
-
-
     //struct for edges in the graph
+    //the coords live in way_coord_buffer[coords_begin .. coords_begin+coords_count) and their
+    //distances from the start of the way at the same indexes of way_coord_offsets,
+    //the ends are crossroads start_ver and end_ver
     struct Way {
     public:
         WayID id;
-        std::vector<Coord>way_coords_vect;
+        std::size_t coords_begin;
+        std::size_t coords_count;
         Distance waylength;
-        Coord start;
-        Coord end_coord;
-        Way_node *startnode;
-        Way_node *endnode;
         int start_ver;
         int end_ver;
-        struct Way *next;
-        struct Way *prev;
 
 
 
@@ -288,87 +444,268 @@ private:
 
         }
 
-        //parametized constructor, calculates its own waylength and start and end coords are saved.
-        Way(WayID id1, std::vector<Coord>way_coords_vect1) {
+        //parametized constructor, the length comes from the offsets of the coords.
+        Way(WayID id1, std::size_t coords_begin1, std::size_t coords_count1, Distance waylength1) {
             id = id1;
-            waylength = 0;
-            way_coords_vect = way_coords_vect1;
-            if (way_coords_vect.size() == 1) {
-                start = way_coords_vect[0];
-                end_coord = way_coords_vect[0];
-                waylength = 0;
-
-            }else {
-                for (unsigned long i = 0; i < way_coords_vect.size()-1; ++i) {
-                    waylength = waylength+way_length(way_coords_vect[i], way_coords_vect[i+1]);
-                }
-            }
-            start = way_coords_vect[0];
-            end_coord = way_coords_vect.back();
+            coords_begin = coords_begin1;
+            coords_count = coords_count1;
+            waylength = waylength1;
 
 
         }
 
 
     };
-    //
-    //
-
-    class graph {
-        Way_node* get_adjlist_node(int value, Distance weight, Way_node* head) {
-            Way_node* new_node = new Way_node;
-            new_node->val = value;
-            new_node->next = head;
-            new_node->val = weight;
-            return new_node;
-        }
-        int nodes; //how many nodes in graph.
+    // a crossroad is a coordinate where at least one way starts or ends.
+    // way_indexes point into ways_vector.
+    struct Crossroad {
+        Coord position;
+        std::vector<int> way_indexes;
+    };
 
-    public:
-        Way_node **head; //adjacency list as array of ptrs
-        //allocate new node
-        graph(Way ways[], int n) {
-            head = new Way_node*[n]();
-            this->nodes = n;
-            //construct directed graph, add edges
-            for (int i = 0; i < n; ++i) {
-                int start_ver = ways[i].start_ver;
-                int end_ver = ways[i].end_ver;
-                Distance weight = ways[i].waylength;
-                Way_node *new_node = get_adjlist_node(end_ver, weight, head[start_ver]);
-                //head pointer to new_node
-                head[start_ver] = new_node;
-            }
+    // Fixed size FIFO of crossroad ids. The storage is sized to the graph once and
+    // reused by every query. A BFS pushes each crossroad at most once, so it never
+    // overflows.
+    struct Crossroad_queue {
+        std::vector<int> items;
+        std::size_t head = 0;
+        std::size_t count = 0;
+
+        void reset(std::size_t capacity);
+        void push(int crossroad);
+        int pop();
+        std::size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+    };
+
+    // Bookkeeping for the route searches, indexed by crossroad id. Index 0 is the
+    // search from fromxy and index 1 the search from toxy. Nothing is cleared between
+    // queries: an entry is valid only if its seen-stamp equals the current stamp,
+    // so a query allocates nothing once the vectors have grown to the graph size.
+    struct Route_scratch {
+        unsigned int stamp = 0;
+        std::vector<unsigned int> seen[2];
+        std::vector<int> parent_way[2];
+        std::vector<Distance> dist[2];
+        Crossroad_queue queue[2];
+        std::vector<std::pair<Distance, int>> heap[2];
+        std::vector<int> edge_path;
+        std::vector<int> way_path;
+        std::vector<std::pair<int, int>> unpack_stack;
+        std::vector<std::pair<int, std::size_t>> dfs_stack;
+
+        void next_query(std::size_t crossroads);
+    };
+
+    // Disjoint sets of crossroad ids with path compression and union by size.
+    // size is only up to date at the roots.
+    struct Union_find {
+        std::vector<int> parent;
+        std::vector<int> size;
+
+        void reset(std::size_t size);
+        void grow(std::size_t size);
+        int find(int item);
+        bool unite(int a, int b);
+        int set_size(int item);
+    };
+
+    // Route cache entries are found by query and ends. An entry is only valid while
+    // its epoch equals graph_epoch, so changing the graph invalidates all of them at once.
+    struct Route_cache_key {
+        RouteKind kind;
+        Coord from;
+        Coord to;
+
+        bool operator==(Route_cache_key const& other) const
+        {
+            return kind == other.kind && from == other.from && to == other.to;
         }
-        //destructor
-        ~graph(){
-            for (int i = 0; i < nodes; ++i) {
-                delete [] head[i];
-                delete [] head;
-            }
+    };
+
+    struct Route_cache_key_hash {
+        std::size_t operator()(Route_cache_key const& key) const
+        {
+            auto hasher = CoordHash();
+            auto fromhash = hasher(key.from);
+            auto tohash = hasher(key.to) + static_cast<std::size_t>(key.kind);
+            return fromhash ^ (tohash + 0x9e3779b9 + (fromhash << 6) + (fromhash >> 2));
         }
     };
 
+    struct Route_cache_entry {
+        Route_cache_key key;
+        unsigned long int epoch;
+        std::vector<std::tuple<Coord, WayID, Distance>> route;
+    };
+
+    // Edge of the contraction hierarchy: either an original way or a shortcut that
+    // replaces children[0] + children[1] around a contracted crossroad.
+    // children[0] touches ends[0] and children[1] touches ends[1].
+    struct Ch_edge {
+        int ends[2];
+        Distance length;
+        int way_index;
+        int children[2];
+    };
+
+    // Edge in the query graph of the hierarchy, always towards a higher ranked crossroad
+    struct Ch_arc {
+        int target;
+        Distance length;
+        int edge;
+    };
+
+    // Straight piece of a way, from its coords index to index+1
+    struct Way_segment {
+        Coord ends[2];
+        int way_index;
+        int index;
+    };
+
+    // Node of the segment bounding box tree. Leaves have children -1 and cover
+    // way_segments[begin .. end).
+    struct Segment_node {
+        int minx, miny, maxx, maxy;
+        int begin;
+        int end;
+        int children[2];
+    };
+
+    // Point on a way. crossroad is >= 0 when the point is one of the ends of the way,
+    // otherwise offset is the distance along the way from its start.
+    struct Snap_point {
+        Coord xy;
+        int way_index;
+        int crossroad;
+        Distance offset;
+    };
+
+    // Chain of ways between two junctions of the compressed graph. Its ways are
+    // chain_ways[first .. first+count), in order from ends[0] to ends[1].
+    struct Chain {
+        int ends[2];
+        Distance length;
+        int first;
+        int count;
+    };
+
+    std::vector<std::tuple<Coord, WayID, Distance>> find_route_least_crossroads(Coord fromxy, Coord toxy,
+                                                                                Route_scratch& scratch) const;
+
+    std::vector<std::tuple<Coord, WayID, Distance>> find_route_shortest_distance(Coord fromxy, Coord toxy,
+                                                                                 Route_scratch& scratch) const;
+
+    std::vector<std::tuple<Coord, WayID, Distance>> const* cached_route(Route_cache_key const& key);
+
+    void remember_route(Route_cache_key const& key, std::vector<std::tuple<Coord, WayID, Distance>> const& route);
+
+    int crossroad_id(Coord xy) const;
+
+    Coord const* coords_of(Way const& way) const;
+
+    void compact_way_coords();
+
+    void rebuild_segment_index();
+
+    int build_segment_node(int begin, int end);
+
+    Snap_point snap(Coord xy) const;
+
+    void attach_places();
+
+    void attach_place(PlaceID id, Coord xy);
+
+    void detach_place(PlaceID id);
+
+    Snap_point const* place_snap(PlaceID id);
 
+    std::vector<std::tuple<Coord, WayID, Distance>> snapped_route(Snap_point const& from, Snap_point const& to,
+                                                                  Route_scratch& scratch) const;
 
-    void make_graph(int edges, Datastructures::Way edgeslist[]);
+    int add_crossroad(Coord xy);
 
-    std::pair<WayID, int>get_shortest_way(std::vector<Way> ways);
+    int other_end(int way_index, int crossroad) const;
 
-    int get_node_index (Coord pos);
+    int bfs_route(int from, int to, Route_scratch& scratch) const;
 
-    bool make_node (Coord pos, Coord next);
+    int bfs_route_bidirectional(int from, int to, Route_scratch& scratch) const;
 
-    static std::string find_way (Coord pos, std::vector<Way> ways_vector);
+    int dijkstra_route(int from, int to, Route_scratch& scratch) const;
 
-    int find_way_distance (Coord pos);
+    int dijkstra_route_bidirectional(int from, int to, Route_scratch& scratch) const;
 
-    std::vector<std::tuple<Coord, WayID, Distance>> route(Coord fromxy, Coord toxy);
+    int spur_dijkstra(int from, int to, std::vector<int> const& blocked_ways, Route_scratch& scratch) const;
+
+    void bounded_dijkstra(int from, Distance budget, std::vector<int>& settled, Route_scratch& scratch) const;
+
+    void dijkstra_to_targets(int from, std::vector<int> const& targets, std::vector<Distance>& row,
+                             Route_scratch& scratch) const;
+
+    std::vector<std::tuple<Coord, WayID, Distance>> build_route(int from, int meet, int to,
+                                                                Route_scratch const& scratch) const;
+
+    std::vector<std::tuple<Coord, WayID, Distance>> build_route_from_ways(int from,
+                                                                          std::vector<int> const& way_path) const;
+
+    void routing_changed();
+
+    void refresh_components();
+
+    bool disconnected(Coord fromxy, Coord toxy);
+
+    void rebuild_way_graph();
+
+    void remove_crossroad(int crossroad);
+
+    std::vector<int> ways_by_length() const;
+
+    std::vector<bool> kruskal_forest() const;
+
+    std::vector<bool> boruvka_forest() const;
+
+    bool shorter_way(int a, int b) const;
+
+    unsigned int thread_count() const;
+
+    int contract_crossroad(int crossroad, bool simulate, std::vector<std::vector<int>>& adjacency,
+                           std::vector<int> const& rank, Route_scratch& witness);
+
+    int ch_route(int from, int to, Route_scratch& scratch) const;
+
+    void unpack_ch_edge(int edge, int from, Route_scratch& scratch) const;
+
+    void landmark_dijkstra(int landmark, std::vector<std::uint32_t>& row,
+                           std::vector<std::pair<Distance, int>>& heap) const;
+
+    void rebuild_landmark_tables();
+
+    void landmarks_way_added(int way_index);
+
+    void landmarks_way_removed(int from, int to, Distance length);
+
+    std::uint32_t landmark_bound(int from, int to) const;
+
+    void route_cache_way_added(int way_index);
+
+    void route_cache_way_removed(WayID const& id, Coord from, Coord to);
+
+    int astar_route(int from, int to, Route_scratch& scratch) const;
+
+    void rebuild_chains();
+
+    void renumber_crossroads();
+
+    bool chain_route(int from, int to, Route_scratch& scratch) const;
 
 
 
     static int way_length(Coord fromxy, Coord toxy);
 
+    static void segment_lengths(Coord const* coords, std::size_t count, Distance* lengths);
+
+    static void polyline_offsets(Coord const* coords, std::size_t count, Distance* offsets);
+
 
     //std::unordered_map <PlaceID, Place> placeId_Places_map; maybe not this
 
@@ -397,9 +734,107 @@ private:
     
     std::vector <Way> ways_vector = {};
 
-    std::vector <Coord> vertexes = {};
+    // coords of every way back to back, removed ways leave holes until compact_way_coords
+    std::vector <Coord> way_coord_buffer = {};
+
+    // distance along its way to each coord of way_coord_buffer, 0 at the start of a way
+    std::vector <Distance> way_coord_offsets = {};
+
+    std::size_t way_coord_holes = 0;
+
+    std::unordered_map <WayID, int> wayID_index_map = {};
+
+    std::unordered_map <Coord, int, CoordHash> coord_crossroad_map = {};
+
+    std::vector <Crossroad> crossroads_vector = {};
+
+    Route_scratch route_scratch = {};
+
+    RouteSearch route_search = RouteSearch::UNIDIRECTIONAL;
+
+    //contraction hierarchy, only used while ch_ready is true
+    std::vector<Ch_edge> ch_edges = {};
+
+    std::vector<int> ch_up_begin = {};
+
+    std::vector<Ch_arc> ch_up_arcs = {};
+
+    bool ch_ready = false;
+
+    //ALT landmarks and their distance tables, one row per landmark indexed by crossroad.
+    //Ways go both directions, so a row is the distance both to and from the landmark.
+    std::vector<int> landmarks = {};
+
+    std::vector<std::vector<std::uint32_t>> landmark_dist = {};
+
+    bool landmarks_stale = false;
+
+    //bounding box tree over the way segments, node 0 is the root
+    std::vector<Way_segment> way_segments = {};
+
+    std::vector<Segment_node> segment_nodes = {};
+
+    bool segments_stale = true;
+
+    //nearest way point of each place, valid while place_snaps_epoch equals graph_epoch
+    std::unordered_map<PlaceID, Snap_point> place_snaps = {};
+
+    unsigned long int place_snaps_epoch = std::numeric_limits<unsigned long int>::max();
+
+    //places attached to each way end crossroad and their distance along the way from it
+    std::vector<std::vector<std::pair<PlaceID, Distance>>> crossroad_places = {};
+
+    //junction graph, chain_of is -1 for junctions and the chain otherwise. chain_pos and
+    //chain_offset tell how many ways and how far from ends[0] of its chain a crossroad is.
+    std::vector<Chain> chains = {};
+
+    std::vector<int> chain_ways = {};
+
+    std::vector<int> chain_of = {};
+
+    std::vector<int> chain_pos = {};
+
+    std::vector<Distance> chain_offset = {};
+
+    std::vector<std::vector<int>> junction_chains = {};
+
+    bool chain_compression = false;
+
+    bool hilbert_order = false;
+
+    bool chains_stale = true;
+
+    //connected components of the crossroads, rebuilt before use when stale
+    Union_find crossroad_components = {};
+
+    bool components_stale = false;
+
+    std::vector<WayID> trimmed_way_ids = {};
+
+    Distance trimmed_total = 0;
+
+    TrimAlgorithm trim_algorithm = TrimAlgorithm::KRUSKAL;
+
+    //bumped by every change to the ways, anything computed for an older epoch is stale
+    unsigned long int graph_epoch = 0;
+
+    //most recently used route first
+    std::list<Route_cache_entry> route_cache_lru = {};
+
+    std::unordered_map<Route_cache_key, std::list<Route_cache_entry>::iterator, Route_cache_key_hash> route_cache_map = {};
+
+    //off until set_route_cache_size is called, so repeated queries still search
+    std::size_t route_cache_limit = 0;
+
+    //newest epoch of any cached route, the repairs skip the walk when it is older than the
+    //previous epoch
+    unsigned long int route_cache_epoch = std::numeric_limits<unsigned long int>::max();
+
+    unsigned long int route_cache_hits = 0;
+
+    unsigned long int route_cache_misses = 0;
 
-    std::vector <Way_node> nodes_vector = {};
+    unsigned int worker_threads = 0;
 
 };
 
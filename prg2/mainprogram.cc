@@ -1470,6 +1470,617 @@ void MainProgram::test_trim_ways()
     ds_.trim_ways();
 }
 
+MainProgram::CmdResult MainProgram::cmd_trimmed_ways(std::ostream &output, MainProgram::MatchIter begin, MainProgram::MatchIter end)
+{
+    assert( begin == end && "Impossible number of parameters!");
+
+    auto wayids = ds_.trimmed_ways();
+    output << "The trimmed ways had a total length of " << ds_.trimmed_length() << endl;
+    if (wayids.empty())
+    {
+        output << "No ways!" << endl;
+    }
+
+    sort(wayids.begin(), wayids.end());
+
+    unsigned int i = 1;
+    for (auto const& wayid : wayids)
+    {
+        output << i <<". " << wayid << endl;
+        ++i;
+    }
+
+    return {};
+}
+
+MainProgram::CmdResult MainProgram::cmd_route_search(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string uni = *begin++;
+    string bi = *begin++;
+    assert(begin == end && "Invalid number of parameters");
+
+    if (!uni.empty())
+    {
+        ds_.set_route_search(RouteSearch::UNIDIRECTIONAL);
+        output << "Route search: unidirectional" << endl;
+    }
+    else if (!bi.empty())
+    {
+        ds_.set_route_search(RouteSearch::BIDIRECTIONAL);
+        output << "Route search: bidirectional" << endl;
+    }
+    else
+    {
+        assert(!"Impossible route search mode!");
+    }
+
+    return {};
+}
+
+MainProgram::CmdResult MainProgram::cmd_prepare_routing(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    assert(begin == end && "Impossible number of parameters!");
+
+    auto shortcuts = ds_.prepare_routing();
+    output << "Routing prepared with " << shortcuts << " shortcuts." << endl;
+
+    return {};
+}
+
+MainProgram::CmdResult MainProgram::cmd_prepare_landmarks(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string countstr = *begin++;
+    assert(begin == end && "Impossible number of parameters!");
+
+    int count = convert_string_to<int>(countstr);
+    auto landmarks = ds_.prepare_landmarks(count);
+    output << "Routing prepared with " << landmarks << " landmarks." << endl;
+
+    return {};
+}
+
+MainProgram::CmdResult MainProgram::cmd_trim_algorithm(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string kruskal = *begin++;
+    string boruvka = *begin++;
+    assert(begin == end && "Invalid number of parameters");
+
+    if (!kruskal.empty())
+    {
+        ds_.set_trim_algorithm(TrimAlgorithm::KRUSKAL);
+        output << "Trim algorithm: kruskal" << endl;
+    }
+    else if (!boruvka.empty())
+    {
+        ds_.set_trim_algorithm(TrimAlgorithm::BORUVKA);
+        output << "Trim algorithm: boruvka" << endl;
+    }
+    else
+    {
+        assert(!"Impossible trim algorithm!");
+    }
+
+    return {};
+}
+
+MainProgram::CmdResult MainProgram::cmd_threads(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string countstr = *begin++;
+    assert(begin == end && "Invalid number of parameters");
+
+    unsigned int count = convert_string_to<unsigned int>(countstr);
+    ds_.set_worker_threads(count);
+    if (count == 0)
+    {
+        output << "Worker threads: one per core" << endl;
+    }
+    else
+    {
+        output << "Worker threads: " << count << endl;
+    }
+
+    return {};
+}
+
+MainProgram::CmdResult MainProgram::cmd_distance_matrix(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string sourcesstr = *begin++;
+    string targetsstr = *begin++;
+    assert(begin == end && "Invalid number of parameters");
+
+    auto parse_coords = [this](string const& coordsstr) {
+        vector<Coord> coords;
+        smatch coord;
+        auto sbeg = coordsstr.cbegin();
+        auto send = coordsstr.cend();
+        for ( ; regex_search(sbeg, send, coord, coords_regex_); sbeg = coord.suffix().first)
+        {
+            coords.push_back({convert_string_to<int>(coord[1]),convert_string_to<int>(coord[2])});
+        }
+        return coords;
+    };
+    vector<Coord> sources = parse_coords(sourcesstr);
+    vector<Coord> targets = parse_coords(targetsstr);
+
+    auto matrix = ds_.distance_matrix(sources, targets);
+    for (unsigned int i = 0; i < sources.size(); ++i)
+    {
+        print_coord(sources[i], output, false);
+        output << ":";
+        for (unsigned int j = 0; j < targets.size(); ++j)
+        {
+            output << " ";
+            if (matrix[i][j] == NO_DISTANCE) { output << "-"; }
+            else { output << matrix[i][j]; }
+        }
+        output << endl;
+    }
+
+    return {};
+}
+
+MainProgram::CmdResult MainProgram::cmd_nearest_by_road(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string xstr = *begin++;
+    string ystr = *begin++;
+    string typestr = *begin++;
+    string countstr = *begin++;
+    assert( begin == end && "Impossible number of parameters!");
+
+    Coord coord = {convert_string_to<int>(xstr),convert_string_to<int>(ystr)};
+    PlaceType type = typestr == "any" ? PlaceType::NO_TYPE : convert_string_to_placetype(typestr);
+    int count = countstr.empty() ? 1 : convert_string_to<int>(countstr);
+
+    auto nearest = ds_.nearest_by_road(coord, type, count);
+    if (!nearest.empty() && nearest.front().first == NO_PLACE)
+    {
+        output << "Starting coord has no ways!" << endl;
+        return {};
+    }
+    if (nearest.empty())
+    {
+        output << "No places found by road!" << endl;
+        return {};
+    }
+
+    vector<PlaceID> places;
+    for (unsigned int i = 0; i < nearest.size(); ++i)
+    {
+        output << i+1 << ". place " << nearest[i].first << " distance " << nearest[i].second << endl;
+        places.push_back(nearest[i].first);
+    }
+    return {ResultType::PLACEIDLIST, CmdResultPlaceIDs{NO_AREA, places}};
+}
+
+MainProgram::CmdResult MainProgram::cmd_route_between_places(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string fromidstr = *begin++;
+    string toidstr = *begin++;
+    string any = *begin++;
+    string least = *begin++;
+    string shortest = *begin++;
+    assert( begin == end && "Impossible number of parameters!");
+
+    PlaceID fromid = convert_string_to<PlaceID>(fromidstr);
+    PlaceID toid = convert_string_to<PlaceID>(toidstr);
+    RouteKind kind = RouteKind::ANY;
+    if (!least.empty()) { kind = RouteKind::LEAST_CROSSROADS; }
+    else if (!shortest.empty()) { kind = RouteKind::SHORTEST_DISTANCE; }
+    else { assert(!any.empty() && "Impossible route kind!"); }
+
+    auto steps = ds_.route_between_places(fromid, toid, kind);
+
+    vector<tuple<Coord, Coord, WayID, Distance>> result;
+
+    if (steps.empty())
+    {
+        output << "No route found!" << endl;
+    }
+    else if (steps.front() == make_tuple(NO_COORD, NO_WAY, NO_DISTANCE))
+    {
+        output << "No such places or no ways!" << endl;
+    }
+    else
+    {
+        auto [coord, wayid, dist] = steps.front();
+        for (auto iter = steps.begin()+1; iter != steps.end(); ++iter)
+        {
+            auto& [ncoord, nwayid, ndist] = *iter;
+            result.emplace_back(coord, ncoord, wayid, dist);
+            coord = ncoord; wayid = nwayid; dist = ndist;
+        }
+        result.emplace_back(coord, NO_COORD, NO_WAY, dist);
+    }
+
+    return {ResultType::ROUTE, result};
+}
+
+MainProgram::CmdResult MainProgram::cmd_route_alternatives(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string fromxstr = *begin++;
+    string fromystr = *begin++;
+    string toxstr = *begin++;
+    string toystr = *begin++;
+    string countstr = *begin++;
+    assert( begin == end && "Impossible number of parameters!");
+
+    Coord fromxy = {convert_string_to<int>(fromxstr),convert_string_to<int>(fromystr)};
+    Coord toxy = {convert_string_to<int>(toxstr),convert_string_to<int>(toystr)};
+    int count = convert_string_to<int>(countstr);
+
+    auto routes = ds_.route_alternatives(fromxy, toxy, count);
+    if (routes.empty())
+    {
+        output << "No route found!" << endl;
+        return {};
+    }
+    if (routes.front().front() == make_tuple(NO_COORD, NO_WAY, NO_DISTANCE))
+    {
+        output << "Starting or destination coord has no ways!" << endl;
+        return {};
+    }
+
+    for (unsigned int i = 0; i < routes.size(); ++i)
+    {
+        output << "Route " << i+1 << ", distance " << std::get<2>(routes[i].back()) << ":" << endl;
+        for (unsigned int j = 0; j < routes[i].size(); ++j)
+        {
+            auto const& [coord, wayid, dist] = routes[i][j];
+            output << j+1 << ". ";
+            print_coord(coord, output, false);
+            if (wayid != NO_WAY) { output << " way " << wayid; }
+            output << " distance " << dist << endl;
+        }
+    }
+
+    return {};
+}
+
+MainProgram::CmdResult MainProgram::cmd_save_snapshot(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string filename = *begin++;
+    assert( begin == end && "Impossible number of parameters!");
+
+    if (ds_.save_snapshot(filename))
+    {
+        output << "Snapshot saved to '" << filename << "'" << endl;
+    }
+    else
+    {
+        output << "Cannot write file '" << filename << "'!" << endl;
+    }
+
+    return {};
+}
+
+MainProgram::CmdResult MainProgram::cmd_load_snapshot(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string filename = *begin++;
+    assert( begin == end && "Impossible number of parameters!");
+
+    if (ds_.load_snapshot(filename))
+    {
+        output << "Snapshot loaded from '" << filename << "': " << ds_.place_count() << " places, "
+               << ds_.all_ways().size() << " ways" << endl;
+        view_dirty = true;
+    }
+    else
+    {
+        output << "Cannot load snapshot '" << filename << "'!" << endl;
+    }
+
+    return {};
+}
+
+MainProgram::CmdResult MainProgram::cmd_snap_to_way(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string xstr = *begin++;
+    string ystr = *begin++;
+    assert(begin == end && "Invalid number of parameters");
+
+    Coord xy = {convert_string_to<int>(xstr), convert_string_to<int>(ystr)};
+    auto [point, wayid, offset] = ds_.snap_to_way(xy);
+    if (wayid == NO_WAY)
+    {
+        output << "No ways!" << endl;
+        return {};
+    }
+
+    print_coord(point, output, false);
+    output << " on way " << wayid << " at distance " << offset << endl;
+
+    return {};
+}
+
+MainProgram::CmdResult MainProgram::cmd_route_between_points(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string fromxstr = *begin++;
+    string fromystr = *begin++;
+    string toxstr = *begin++;
+    string toystr = *begin++;
+    assert( begin == end && "Impossible number of parameters!");
+
+    Coord fromxy = {convert_string_to<int>(fromxstr),convert_string_to<int>(fromystr)};
+    Coord toxy = {convert_string_to<int>(toxstr),convert_string_to<int>(toystr)};
+
+    auto steps = ds_.route_between_points(fromxy, toxy);
+
+    vector<tuple<Coord, Coord, WayID, Distance>> result;
+
+    if (steps.empty())
+    {
+        output << "No route found!" << endl;
+    }
+    else if (steps.front() == make_tuple(NO_COORD, NO_WAY, NO_DISTANCE))
+    {
+        output << "No ways!" << endl;
+    }
+    else
+    {
+        auto [coord, wayid, dist] = steps.front();
+        for (auto iter = steps.begin()+1; iter != steps.end(); ++iter)
+        {
+            auto& [ncoord, nwayid, ndist] = *iter;
+            result.emplace_back(coord, ncoord, wayid, dist);
+            coord = ncoord; wayid = nwayid; dist = ndist;
+        }
+        result.emplace_back(coord, NO_COORD, NO_WAY, dist);
+    }
+
+    return {ResultType::ROUTE, result};
+}
+
+void MainProgram::test_route_between_points()
+{
+    // Choose two random points, they don't have to be on any way
+    Coord coord1 = n_to_coord(random(decltype(random_ways_added_)(0),random_ways_added_));
+    Coord coord2 = n_to_coord(random(decltype(random_ways_added_)(0),random_ways_added_));
+    coord1.x += random(0, 10);
+    coord2.y += random(0, 10);
+
+    ds_.route_between_points(coord1, coord2);
+}
+
+MainProgram::CmdResult MainProgram::cmd_hilbert_order(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string on = *begin++;
+    string off = *begin++;
+    assert(begin == end && "Invalid number of parameters");
+
+    if (!on.empty())
+    {
+        ds_.set_hilbert_order(true);
+        output << "Hilbert order: on (crossroads are renumbered on creation_finished)" << endl;
+    }
+    else if (!off.empty())
+    {
+        ds_.set_hilbert_order(false);
+        output << "Hilbert order: off" << endl;
+    }
+    else
+    {
+        assert(!"Impossible Hilbert order mode!");
+    }
+
+    return {};
+}
+
+MainProgram::CmdResult MainProgram::cmd_chain_compression(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string on = *begin++;
+    string off = *begin++;
+    assert(begin == end && "Invalid number of parameters");
+
+    if (!on.empty())
+    {
+        ds_.set_chain_compression(true);
+        output << "Chain compression: on" << endl;
+    }
+    else if (!off.empty())
+    {
+        ds_.set_chain_compression(false);
+        output << "Chain compression: off" << endl;
+    }
+    else
+    {
+        assert(!"Impossible chain compression mode!");
+    }
+
+    return {};
+}
+
+MainProgram::CmdResult MainProgram::cmd_component_size(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string xstr = *begin++;
+    string ystr = *begin++;
+    assert(begin == end && "Invalid number of parameters");
+
+    Coord coord = {convert_string_to<int>(xstr), convert_string_to<int>(ystr)};
+
+    int size = ds_.component_size(coord);
+    if (size == 0)
+    {
+        output << "No crossroad at ";
+        print_coord(coord, output);
+        return {};
+    }
+    output << "Crossroads connected to ";
+    print_coord(coord, output, false);
+    output << ": " << size << endl;
+
+    return {};
+}
+
+void MainProgram::test_component_size()
+{
+    if (random_ways_added_ > 0) // Don't do anything if there's no ways
+    {
+        auto coord = n_to_coord(random(decltype(random_ways_added_)(0),random_ways_added_));
+        ds_.component_size(coord);
+    }
+}
+
+MainProgram::CmdResult MainProgram::cmd_are_connected(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string fromxstr = *begin++;
+    string fromystr = *begin++;
+    string toxstr = *begin++;
+    string toystr = *begin++;
+    assert(begin == end && "Invalid number of parameters");
+
+    Coord from = {convert_string_to<int>(fromxstr), convert_string_to<int>(fromystr)};
+    Coord to = {convert_string_to<int>(toxstr), convert_string_to<int>(toystr)};
+
+    print_coord(from, output, false);
+    output << (ds_.are_connected(from, to) ? " is connected to " : " is not connected to ");
+    print_coord(to, output);
+
+    return {};
+}
+
+MainProgram::CmdResult MainProgram::cmd_route_batch(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string any = *begin++;
+    string least = *begin++;
+    string shortest = *begin++;
+    string coordsstr = *begin++;
+    assert(begin == end && "Invalid number of parameters");
+
+    RouteKind kind = RouteKind::ANY;
+    if (!least.empty()) { kind = RouteKind::LEAST_CROSSROADS; }
+    else if (!shortest.empty()) { kind = RouteKind::SHORTEST_DISTANCE; }
+    else { assert(!any.empty() && "Impossible route kind!"); }
+
+    vector<Coord> coords;
+    smatch coord;
+    auto sbeg = coordsstr.cbegin();
+    auto send = coordsstr.cend();
+    for ( ; regex_search(sbeg, send, coord, coords_regex_); sbeg = coord.suffix().first)
+    {
+        coords.push_back({convert_string_to<int>(coord[1]),convert_string_to<int>(coord[2])});
+    }
+    if (coords.size() % 2 != 0)
+    {
+        output << "Coordinates must be given in from-to pairs!" << endl;
+        return {};
+    }
+
+    vector<std::pair<Coord, Coord>> queries;
+    for (unsigned int i = 0; i < coords.size(); i += 2)
+    {
+        queries.push_back({coords[i], coords[i+1]});
+    }
+
+    auto results = ds_.route_batch(queries, kind);
+    for (unsigned int i = 0; i < queries.size(); ++i)
+    {
+        output << i+1 << ". ";
+        print_coord(queries[i].first, output, false);
+        output << " -> ";
+        print_coord(queries[i].second, output, false);
+        auto const& route = results[i];
+        if (route.empty())
+        {
+            output << ": No route found" << endl;
+        }
+        else if (std::get<0>(route.front()) == NO_COORD)
+        {
+            output << ": Not a crossroad" << endl;
+        }
+        else
+        {
+            output << ": " << route.size()-1 << " ways, distance " << std::get<2>(route.back()) << endl;
+        }
+    }
+
+    return {};
+}
+
+void MainProgram::test_route_batch()
+{
+    // A batch of random routes, large enough to keep all of the worker threads busy
+    std::vector<std::pair<Coord, Coord>> queries;
+    for (unsigned int i = 0; i < 100; ++i)
+    {
+        Coord coord1 = n_to_coord(random(decltype(random_ways_added_)(0),random_ways_added_));
+        Coord coord2 = n_to_coord(random(decltype(random_ways_added_)(0),random_ways_added_));
+        queries.push_back({coord1, coord2});
+    }
+
+    ds_.route_batch(queries, RouteKind::SHORTEST_DISTANCE);
+}
+
+MainProgram::CmdResult MainProgram::cmd_reachable_within(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string xstr = *begin++;
+    string ystr = *begin++;
+    string budgetstr = *begin++;
+    assert(begin == end && "Invalid number of parameters");
+
+    Coord from = {convert_string_to<int>(xstr), convert_string_to<int>(ystr)};
+    auto budget = convert_string_to<Distance>(budgetstr);
+
+    auto result = ds_.reachable_within(from, budget);
+    if (result.empty())
+    {
+        output << "No crossroads within " << budget << " of ";
+        print_coord(from, output);
+        return {};
+    }
+    for (unsigned int i = 0; i < result.size(); ++i)
+    {
+        output << i+1 << ". ";
+        print_coord(result[i].first, output, false);
+        output << " distance " << result[i].second << endl;
+    }
+
+    return {};
+}
+
+MainProgram::CmdResult MainProgram::cmd_places_reachable_within(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string xstr = *begin++;
+    string ystr = *begin++;
+    string budgetstr = *begin++;
+    assert(begin == end && "Invalid number of parameters");
+
+    Coord from = {convert_string_to<int>(xstr), convert_string_to<int>(ystr)};
+    auto budget = convert_string_to<Distance>(budgetstr);
+
+    auto places = ds_.places_reachable_within(from, budget);
+    if (places.empty())
+    {
+        output << "No places within " << budget << " of ";
+        print_coord(from, output);
+    }
+
+    sort(places.begin(), places.end());
+    return {ResultType::PLACEIDLIST, CmdResultPlaceIDs{NO_AREA, places}};
+}
+
+MainProgram::CmdResult MainProgram::cmd_route_cache_size(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string sizestr = *begin++;
+    assert(begin == end && "Invalid number of parameters");
+
+    auto size = convert_string_to<std::size_t>(sizestr);
+    ds_.set_route_cache_size(size);
+    output << "Route cache size: " << size << endl;
+
+    return {};
+}
+
+MainProgram::CmdResult MainProgram::cmd_route_cache_stats(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    assert(begin == end && "Invalid number of parameters");
+
+    auto stats = ds_.route_cache_stats();
+    output << "Route cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+           << stats.entries << "/" << stats.limit << " entries" << endl;
+
+    return {};
+}
+
 MainProgram::CmdResult MainProgram::cmd_clear_ways(std::ostream& output, MainProgram::MatchIter begin, MainProgram::MatchIter end)
 {
     assert( begin == end && "Impossible number of parameters!");
@@ -1530,9 +2141,36 @@ vector<MainProgram::CmdInfo> MainProgram::cmds_ =
     {"route_shortest_distance", "CoordFrom CoordTo", coordx+wsx+coordx, &MainProgram::cmd_route_shortest_distance, &MainProgram::test_route_shortest_distance },
     {"route_with_cycle", "Coordfrom", coordx, &MainProgram::cmd_route_with_cycle, &MainProgram::test_route_with_cycle },
     {"trim_ways", "", "", &MainProgram::cmd_trim_ways, &MainProgram::test_trim_ways },
+    {"trimmed_ways", "", "", &MainProgram::cmd_trimmed_ways, nullptr },
+    {"trim_algorithm", "kruskal|boruvka (alternatives separated by |)", "(?:(kruskal)|(boruvka))", &MainProgram::cmd_trim_algorithm, nullptr },
+    {"threads", "number_of_threads (0 = one per core)", numx, &MainProgram::cmd_threads, nullptr },
+    {"nearest_by_road", "Coord type [count] (count optional, type 'any' for all types)", coordx+wsx+typex+"(?:"+wsx+numx+")?",
+     &MainProgram::cmd_nearest_by_road, nullptr },
+    {"route_between_places", "PlaceIDFrom PlaceIDTo any|least_crossroads|shortest_distance",
+     plcidx+wsx+plcidx+wsx+"(?:(any)|(least_crossroads)|(shortest_distance))", &MainProgram::cmd_route_between_places, nullptr },
+    {"route_alternatives", "CoordFrom CoordTo max_number_of_routes", coordx+wsx+coordx+wsx+numx, &MainProgram::cmd_route_alternatives, nullptr },
+    {"snap_to_way", "Coord", coordx, &MainProgram::cmd_snap_to_way, nullptr },
+    {"route_between_points", "CoordFrom CoordTo", coordx+wsx+coordx, &MainProgram::cmd_route_between_points, &MainProgram::test_route_between_points },
+    {"hilbert_order", "on|off (alternatives separated by |)", "(?:(on)|(off))", &MainProgram::cmd_hilbert_order, nullptr },
+    {"chain_compression", "on|off (alternatives separated by |)", "(?:(on)|(off))", &MainProgram::cmd_chain_compression, nullptr },
+    {"are_connected", "CoordFrom CoordTo", coordx+wsx+coordx, &MainProgram::cmd_are_connected, nullptr },
+    {"component_size", "Coord", coordx, &MainProgram::cmd_component_size, &MainProgram::test_component_size },
+    {"route_batch", "any|least_crossroads|shortest_distance (x,y) (x,y)... (from-to pairs)",
+     "(?:(any)|(least_crossroads)|(shortest_distance))((?:"+wsx+optcoordx+")+)", &MainProgram::cmd_route_batch, &MainProgram::test_route_batch },
+    {"reachable_within", "Coord max_distance", coordx+wsx+numx, &MainProgram::cmd_reachable_within, nullptr },
+    {"places_reachable_within", "Coord max_distance", coordx+wsx+numx, &MainProgram::cmd_places_reachable_within, nullptr },
+    {"distance_matrix", "(x,y)... -> (x,y)... (sources -> targets)", "("+optcoordx+"(?:"+wsx+optcoordx+")*)"+wsx+"->"+wsx+"("+optcoordx+"(?:"+wsx+optcoordx+")*)",
+     &MainProgram::cmd_distance_matrix, nullptr },
+    {"route_cache_size", "max_number_of_cached_routes (0 = no cache)", numx, &MainProgram::cmd_route_cache_size, nullptr },
+    {"route_cache_stats", "", "", &MainProgram::cmd_route_cache_stats, nullptr },
+    {"route_search", "uni|bi (alternatives separated by |)", "(?:(uni)|(bi))", &MainProgram::cmd_route_search, nullptr },
+    {"prepare_routing", "", "", &MainProgram::cmd_prepare_routing, nullptr },
+    {"prepare_landmarks", "number_of_landmarks", numx, &MainProgram::cmd_prepare_landmarks, nullptr },
     {"quit", "", "", nullptr, nullptr },
     {"help", "", "", &MainProgram::help_command, nullptr },
     {"read", "\"in-filename\" [silent]", "\"([-a-zA-Z0-9 ./:_]+)\"(?:"+wsx+"(silent))?", &MainProgram::cmd_read, nullptr },
+    {"save_snapshot", "\"out-filename\"", "\"([-a-zA-Z0-9 ./:_]+)\"", &MainProgram::cmd_save_snapshot, nullptr },
+    {"load_snapshot", "\"in-filename\"", "\"([-a-zA-Z0-9 ./:_]+)\"", &MainProgram::cmd_load_snapshot, nullptr },
     {"testread", "\"in-filename\" \"out-filename\"", "\"([-a-zA-Z0-9 ./:_]+)\""+wsx+"\"([-a-zA-Z0-9 ./:_]+)\"", &MainProgram::cmd_testread, nullptr },
     {"perftest", "cmd1|all|compulsory[;cmd2...] timeout repeat_count n1[;n2...] (parts in [] are optional, alternatives separated by |)",
      "([0-9a-zA-Z_]+(?:;[0-9a-zA-Z_]+)*)"+wsx+numx+wsx+numx+wsx+"([0-9]+(?:;[0-9]+)*)", &MainProgram::cmd_perftest, nullptr },
@@ -1559,8 +2197,8 @@ MainProgram::CmdResult MainProgram::cmd_perftest(std::ostream& output, MatchIter
 #endif // _GLIBCXX_DEBUG
 
     vector<string> optional_cmds({"places_closest_to", "places_common_area", "route_least_crossroads", "route_with_cycle", "route_shortest_distance",
-                                  "add_walking_connections"});
-    vector<string> nondefault_cmds({"remove_place", "find_places", "way_coords"});
+                                  "add_walking_connections", "route_between_points", "component_size"});
+    vector<string> nondefault_cmds({"remove_place", "find_places", "way_coords", "route_batch"});
 
     string commandstr = *begin++;
     unsigned int timeout = convert_string_to<unsigned int>(*begin++);
@@ -138,6 +138,30 @@ private:
     CmdResult cmd_route_shortest_distance(std::ostream& output, MatchIter begin, MatchIter end);
     CmdResult cmd_route_with_cycle(std::ostream& output, MatchIter begin, MatchIter end);
     CmdResult cmd_trim_ways(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_trimmed_ways(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_trim_algorithm(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_threads(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_nearest_by_road(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_route_between_places(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_route_alternatives(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_save_snapshot(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_load_snapshot(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_snap_to_way(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_route_between_points(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_hilbert_order(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_chain_compression(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_are_connected(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_component_size(std::ostream& output, MatchIter begin, MatchIter end);
+    void test_component_size();
+    CmdResult cmd_route_batch(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_reachable_within(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_places_reachable_within(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_distance_matrix(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_route_cache_size(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_route_cache_stats(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_route_search(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_prepare_routing(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_prepare_landmarks(std::ostream& output, MatchIter begin, MatchIter end);
     CmdResult cmd_random_add(std::ostream& output, MatchIter begin, MatchIter end);
     CmdResult cmd_random_ways(std::ostream& output, MatchIter begin, MatchIter end);
     CmdResult cmd_randseed(std::ostream& output, MatchIter begin, MatchIter end);
@@ -169,6 +193,8 @@ private:
     void test_route_shortest_distance();
     void test_route_with_cycle();
     void test_trim_ways();
+    void test_route_batch();
+    void test_route_between_points();
 
     void add_random_places_areas(unsigned int size, Coord min = {1,1}, Coord max = {10000, 10000});
     void add_random_ways(unsigned int n);